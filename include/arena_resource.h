@@ -0,0 +1,83 @@
+#ifndef ARENA_RESOURCE_H
+#define ARENA_RESOURCE_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <unordered_map>
+#include "physical_memory.h"
+#include "buddy_allocator.h"
+
+/*
+Backed arenas
+- The allocator engines only track metadata (ids and simulated addresses)
+- An Arena owns a real, page aligned byte range of the same size
+- ArenaResource maps engine addresses into the arena and hands out pointers
+
+Pointer:
+pointer = arena_base + simulated_address
+
+ArenaResource is a std::pmr::memory_resource, so standard containers
+(std::pmr::vector, std::pmr::list, ...) can allocate from any engine.
+*/
+
+//Real aligned byte range (optionally mmap'd with huge pages)
+class Arena {
+public:
+    Arena();
+    ~Arena();
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    //Allocate the backing bytes, returns false on failure
+    bool init(std::size_t size, bool huge_pages);
+    //Release the backing bytes
+    void release();
+
+    unsigned char *base() const { return base_; }
+    std::size_t size() const { return size_; }
+    bool huge_pages() const { return huge_pages_; }
+
+private:
+    unsigned char *base_;
+    std::size_t size_;
+    std::size_t mapped_size_;
+    bool mmapped_;
+    bool huge_pages_;
+};
+
+//Engine backing an ArenaResource
+enum class ArenaEngine {
+    PHYSICAL,
+    BUDDY
+};
+
+class ArenaResource : public std::pmr::memory_resource {
+public:
+    //The resource initializes the engine to cover the whole arena.
+    //Compaction is switched off on PhysicalMemory, as it would move live objects.
+    ArenaResource(PhysicalMemory &phys, std::size_t arena_size, bool huge_pages);
+    ArenaResource(BuddyAllocator &buddy, std::size_t arena_size, bool huge_pages);
+
+    //True if the arena and engine were initialized successfully
+    bool ready() const { return ready_; }
+    bool huge_pages() const { return arena_.huge_pages(); }
+    //Number of live allocations handed out
+    std::size_t live() const { return live_.size(); }
+
+private:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+
+private:
+    ArenaEngine engine_;
+    PhysicalMemory *phys_;
+    BuddyAllocator *buddy_;
+    Arena arena_;
+    bool ready_;
+    //pointer handed out -> engine block id
+    std::unordered_map<void *, AllocId> live_;
+};
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <cstddef>
+
+/*
+Benchmarks
+- Measure how fast the simulator engines themselves run
+- Results are printed to std::cout as ns per operation
+*/
+
+//Run standard containers on every allocator engine (backed arenas)
+//and on the default heap. count = number of container elements.
+void bench_arena(std::size_t count, bool huge_pages);
+
+//Encode and decode count synthetic trace records (single and multi
+//threaded) and compare decode speed with Cache::access on the same addresses
+void bench_trace(std::size_t count);
+
+//Replay count references through the runtime Cache and through the
+//compile-time specialized kernel of the same geometry
+void bench_cache(std::size_t cache_size, std::size_t block_size, std::size_t ways, std::size_t count);
+
+#endif
@@ -3,27 +3,92 @@
 
 #include <vector>
 #include <list>
-#include <unordered_map>
 #include <cstddef>
+#include "handle_table.h"
 
+/*
+Memory of any size is decomposed, Linux-style, into naturally aligned
+power of two regions: at every address the largest block that starts
+there and still fits (at most max order = floor(log2(total size))).
+A buddy outside the memory or zone is never free, so such blocks
+simply never merge.
 
+Zones split the memory into DMA (lowest addresses), NORMAL and MOVABLE
+(highest addresses), each with its own free lists and watermarks.
+A request prefers one zone and falls back to the zones below it:
+    MOVABLE -> NORMAL -> DMA,  NORMAL -> DMA,  DMA only
+The first pass only takes zones that stay above their low watermark; a
+second pass goes down to the min watermark and counts a kswapd wakeup
+for every zone below low (there is no reclaim, the count shows pressure).
+*/
+
+enum class ZoneType {
+    DMA,
+    NORMAL,
+    MOVABLE
+};
 
 class BuddyAllocator {
 public:
     BuddyAllocator();
 
-    //initialize with total memory size (must be power of two)
+    //initialize with total memory size, one NORMAL zone
     bool init(std::size_t total_size);
-    //allocate memory (rounded to nearest power of two)
-    int malloc(std::size_t size);
+    //split the memory into zones (sizes may be 0), starts with empty memory
+    bool set_zones(std::size_t dma_size, std::size_t movable_size);
+    //whether set_zones would accept these sizes
+    bool zones_valid(std::size_t dma_size, std::size_t movable_size) const;
+    //min watermark in bytes; low = min * 5/4, high = min * 3/2
+    bool set_watermark(ZoneType zone, std::size_t min);
+    //allocate memory (rounded to nearest power of two) from the NORMAL zonelist
+    AllocId malloc(std::size_t size);
+    //allocate preferring a zone
+    AllocId malloc_zone(std::size_t size, ZoneType zone);
     //free previously allocated block
-    bool free_block(int id);
+    bool free_block(AllocId id);
+    //blocks of order k start on a multiple of 2^k, so alignment (a power
+    //of two) only raises the order
+    AllocId malloc_aligned(std::size_t size, std::size_t alignment);
+    //resize: shrinking frees the upper halves, growing merges free buddies
+    //in place when the block is their left half, otherwise moves the block;
+    //the id stays valid, false leaves the block unchanged
+    bool realloc(AllocId id, std::size_t size);
+    //batch interface: ids[i] answers sizes[i] (INVALID_ID on failure),
+    //returns the number of successful requests
+    std::size_t malloc_batch(const std::vector<std::size_t> &sizes, std::vector<AllocId> &ids);
+    std::size_t free_batch(const std::vector<AllocId> &ids);
+    //look up the start address of an allocated block
+    bool address_of(AllocId id, std::size_t &address) const;
     //dump free lists and allocated blocks
     void dump() const;
     //statistics
     void stats() const;
+    double utilization() const;
+    double external_fragmentation() const;
+    std::size_t alloc_requests() const { return total_alloc_requests_; }
+    std::size_t failed_allocs() const { return failed_allocs_; }
+    std::size_t total_size() const { return total_size_; }
+    //checkpoint
+    void save(CheckpointWriter &out) const;
+    bool load(CheckpointReader &in);
 
 private:
+    struct Zone {
+        ZoneType type;
+        std::size_t start;
+        std::size_t size;
+        std::size_t used;
+        //free lists: free_lists[k] = list of free blocks of size 2^k
+        std::vector<std::list<std::size_t>> free_lists;
+        std::size_t wmark_min;
+        std::size_t wmark_low;
+        std::size_t wmark_high;
+        std::size_t allocs;
+        std::size_t fallback_allocs;
+        std::size_t kswapd_wakeups;
+        std::size_t failed;
+    };
+
     //helper utilities
     bool is_power_of_two(std::size_t x) const;
     std::size_t next_power_of_two(std::size_t x) const;
@@ -31,25 +96,44 @@ private:
     std::size_t order_to_size(int order) const;
 
     //allocation helpers
-    int allocate_block(int order);
-    void split_block(int from_order, int to_order);
-    void try_coalesce(std::size_t addr, int order);
+    AllocId allocate_request(std::size_t size, int min_order, ZoneType preferred);
+    //zone to take a block of order from, following the zonelist and
+    //watermark passes; nullptr if none, mark = watermark that applied,
+    //fallback = the zone is not the first of the zonelist
+    Zone *pick_zone(int order, ZoneType preferred, std::size_t &mark, bool &fallback);
+    //first zone of the zonelist of a request preferring type
+    Zone *home_zone(ZoneType preferred);
+    //take a free block of exactly order, splitting a larger one, false if none
+    bool take_block(Zone &zone, int order, std::size_t &addr);
+    //remove addr from the free list of order, false if it is not free
+    bool take_free(Zone &zone, std::size_t addr, int order);
+    void split_block(Zone &zone, int from_order, int to_order);
+    void try_coalesce(Zone &zone, std::size_t addr, int order);
+    //zone that owns an address
+    std::size_t zone_index(std::size_t addr) const;
+    void add_zone(ZoneType type, std::size_t start, std::size_t size);
+    static const char *zone_name(ZoneType type);
 
 private:
     //memory configuration
     std::size_t total_size_;
     int max_order_;
-    //free lists: free_lists[k] = list of free blocks of size 2^k
-    std::vector<std::list<std::size_t>> free_lists_;
+    //zones in address order
+    std::vector<Zone> zones_;
     //allocated blocks: id -> (address, order)
-    std::unordered_map<int, std::pair<std::size_t, int>> allocated_;
-    //bookkeeping
-    int next_id_;
+    HandleTable<std::pair<std::size_t, int>> allocated_;
     //statistics
     std::size_t used_memory_;
     std::size_t total_alloc_requests_;
     std::size_t successful_allocs_;
     std::size_t failed_allocs_;
+    std::size_t invalid_frees_;
+    std::size_t aligned_allocs_;
+    std::size_t reallocs_;
+    std::size_t reallocs_in_place_;
+    std::size_t realloc_bytes_copied_;
+    std::size_t batches_;
+    std::size_t batched_requests_;
 };
 
 #endif
\ No newline at end of file
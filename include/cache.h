@@ -3,8 +3,17 @@
 
 #include <vector>
 #include <deque>
+#include <list>
 #include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include "checkpoint.h"
+
+class CacheKernel;
+class WayPartition;
 
 /*
   Set-Associative cache(FIFO Replacement)
@@ -14,24 +23,68 @@
   associativity:number of ways per set
  
   number_of_sets = cache_size / (block_size * associativity)
+
+  Registered geometries run on a compile-time specialized kernel
+  (fixed_cache.h), everything else on the runtime sets below.
+
+  Optional analysis:
+  - 3C miss classification: compulsory (block never seen), capacity
+    (also misses in a fully-associative LRU shadow of equal capacity),
+    conflict (hits in the shadow)
+  - Victim cache: small fully-associative buffer of blocks evicted from
+    this level, swapped back in on a hit
+  - Way partitioning (cache_partition.h): per-tenant way masks and UCP;
+    partitioned caches always use the runtime sets, lines record their
+    way and owner
 */
 
+//Kind of memory reference (write policies are not simulated,
+//the type only feeds per-type statistics)
+enum class AccessType : std::uint8_t {
+    READ = 0,
+    WRITE = 1,
+    IFETCH = 2
+};
+
 class Cache {
 public:
     Cache();
+    ~Cache();
+    Cache(Cache &&);
+    Cache &operator=(Cache &&);
 
     //Initialize cache parameters
     //Returns false if configuration is invalid
+    //specialize = use a compile-time kernel if the geometry has one
     bool init(const std::string &name,
               std::size_t cache_size,
               std::size_t block_size,
-              std::size_t associativity);
+              std::size_t associativity,
+              bool specialize = true);
+    bool specialized() const { return kernel_ != nullptr; }
 
     //Access a memory address
     //Returns true if HIT, false if MISS
-    bool access(std::size_t address);
+    bool access(std::size_t address, AccessType type = AccessType::READ);
+    //Functional warming: update contents without touching statistics
+    bool warm(std::size_t address);
     //Reset cache contents and statistics
     void reset();
+    //3C miss classification on/off (clears its statistics)
+    void set_classification(bool enabled);
+    bool classification() const { return classify_; }
+    //Attach a victim cache of entries blocks (0 = detach)
+    void set_victim(std::size_t entries);
+    std::size_t victim_entries() const { return victim_entries_; }
+    std::size_t victim_hits() const { return victim_hits_; }
+    //Tenant (trace stream) of the following references
+    void set_tenant(std::uint32_t stream);
+    //Limit fills of tenant to a contiguous way mask, starts partitioning
+    bool set_way_mask(std::uint32_t tenant, std::uint64_t mask);
+    //UCP repartitioning every interval references (0 = static), starts partitioning
+    bool set_ucp(std::size_t interval);
+    void clear_partitioning();
+    bool partitioned() const { return partition_ != nullptr; }
     //Dump cache contents(per set, FIFO order)
     void dump() const;
     //Print cache statistics
@@ -39,12 +92,20 @@ public:
     // Stats getters(for hierarchy reporting)
     std::size_t hits() const { return hits_; }
     std::size_t misses() const { return misses_; }
+    std::size_t hits(AccessType type) const { return type_hits_[static_cast<int>(type)]; }
+    std::size_t misses(AccessType type) const { return type_misses_[static_cast<int>(type)]; }
+    //Checkpoint
+    void save(CheckpointWriter &out) const;
+    bool load(CheckpointReader &in);
 
 private:
     //Cache line metadata
     struct CacheLine {
         bool valid;
         std::size_t tag;
+        //only maintained while partitioned
+        std::uint8_t way;
+        std::uint8_t owner;
     };
     //Cache configuration
     std::string name_;
@@ -57,15 +118,50 @@ private:
     std::size_t index_bits_;
     //Cache storage: vector of sets, FIFO per set
     std::vector<std::deque<CacheLine>> sets_;
+    //Specialized storage, replaces sets_ when present
+    std::unique_ptr<CacheKernel> kernel_;
     //Statistics
     std::size_t hits_;
     std::size_t misses_;
+    std::size_t type_hits_[3];
+    std::size_t type_misses_[3];
+    //3C classification: blocks ever touched + FA LRU shadow (MRU first)
+    bool classify_;
+    std::unordered_set<std::size_t> touched_;
+    std::list<std::size_t> shadow_lru_;
+    std::unordered_map<std::size_t, std::list<std::size_t>::iterator> shadow_;
+    std::size_t compulsory_;
+    std::size_t capacity_;
+    std::size_t conflict_;
+    //Victim cache: evicted block numbers, oldest first
+    std::size_t victim_entries_;
+    std::deque<std::size_t> victim_;
+    std::size_t victim_hits_;
+    //Way partitioning, nullptr when every tenant may fill every way
+    std::unique_ptr<WayPartition> partition_;
+    std::uint32_t tenant_;
 
 private:
     //Helpers
     bool is_power_of_two(std::size_t x) const;
     std::size_t extract_index(std::size_t address) const;
     std::size_t extract_tag(std::size_t address) const;
+    //Lookup and FIFO fill shared by access and warm
+    //evicted_block (if given) receives the replaced block number or NO_BLOCK
+    bool lookup_fill(std::size_t address, std::size_t *evicted_block = nullptr);
+    //Shared by access and warm: shadow update, classification, victim swap
+    bool reference(std::size_t address, bool record, AccessType type);
+    //Update the shadow structures, classify a miss if record
+    void classify(std::size_t block, bool hit, bool record);
+    //Take block from the victim cache, insert the evicted block
+    bool victim_exchange(std::size_t block, std::size_t evicted_block);
+    void clear_analysis();
+    //Fill restricted to the current tenant's ways
+    bool lookup_fill_partitioned(std::size_t index, std::size_t tag, std::size_t *evicted_block);
+    //Move the lines to way-tracking runtime sets and attach the partition
+    bool start_partitioning();
+    //Tags of one set in FIFO order, for either storage
+    void set_tags(std::size_t set, std::vector<std::size_t> &tags) const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef CACHE_PARTITION_H
+#define CACHE_PARTITION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "checkpoint.h"
+
+/*
+CAT-style way partitioning of one cache level
+- Every reference belongs to a tenant (class of service). Replay uses the
+  trace stream id; streams beyond MAX_TENANTS share tenant stream % MAX_TENANTS
+- Each tenant has a contiguous way mask. Lookups hit in any way, but a
+  tenant fills (and therefore evicts) only inside its own mask
+- Optional UCP (utility-based partitioning): per-tenant monitors keep LRU
+  shadow tags of a few sampled sets and count hits per stack position.
+  Every interval references the lookahead algorithm hands out ways by
+  marginal utility and rewrites the masks of the tenants seen meanwhile
+
+WayPartition only holds the policy state and statistics; the cache keeps
+the lines and asks it which ways a fill may use.
+*/
+
+class WayPartition {
+public:
+    static constexpr std::size_t MAX_TENANTS = 16;
+    static constexpr std::size_t MAX_WAYS = 64;
+
+    WayPartition(std::size_t ways, std::size_t sets);
+
+    static std::uint32_t tenant_of(std::uint32_t stream) { return stream % MAX_TENANTS; }
+
+    std::uint64_t full_mask() const;
+    std::uint64_t mask(std::uint32_t tenant) const { return masks_[tenant]; }
+    //False if the mask is empty, wider than the cache or not contiguous
+    bool set_mask(std::uint32_t tenant, std::uint64_t mask);
+    //Dynamic repartitioning every interval references (0 = static masks)
+    void set_ucp(std::size_t interval);
+    std::size_t ucp_interval() const { return interval_; }
+
+    //One reference: utility monitor and repartition countdown
+    void observe(std::uint32_t tenant, std::size_t set, std::size_t tag);
+    //Measured outcome of a reference
+    void record(std::uint32_t tenant, bool hit) { (hit ? hits_ : misses_)[tenant]++; }
+    //Line ownership changes
+    void filled(std::uint32_t owner) { occupancy_[owner]++; }
+    void evicted(std::uint32_t owner) { occupancy_[owner]--; }
+
+    //Contents restart: occupancy, monitors and counters (masks stay)
+    void clear();
+    void stats(std::size_t lines) const;
+    void save(CheckpointWriter &out) const;
+    //Occupancy is not stored, the cache rebuilds it from its lines
+    bool load(CheckpointReader &in);
+
+private:
+    void repartition();
+
+private:
+    std::size_t ways_;
+    //Monitored sets: every stride-th set
+    std::size_t stride_;
+    std::size_t sampled_;
+    std::vector<std::uint64_t> masks_;
+    std::vector<std::uint64_t> hits_;
+    std::vector<std::uint64_t> misses_;
+    std::vector<std::uint64_t> occupancy_;
+    //UCP: shadow tags per (tenant, sampled set), MRU first
+    std::size_t interval_;
+    std::size_t countdown_;
+    std::size_t repartitions_;
+    std::vector<std::vector<std::size_t>> shadow_;
+    //Hits per LRU stack position, per tenant (ways_ counters each)
+    std::vector<std::uint64_t> way_hits_;
+    //References per tenant in the current interval
+    std::vector<std::uint64_t> interval_refs_;
+};
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/*
+Binary checkpoint format
+- Fixed header: magic "MEMSIMCK" + format version
+- Followed by tagged sections, one per simulator component
+- Values are raw native-endian PODs, strings are length-prefixed
+
+| MAGIC (8) | VERSION (4) | TAG (4) | SECTION DATA | TAG (4) | ... |
+
+The writer buffers the whole image and writes it with one call.
+The reader mmaps the file and decodes straight from the mapping,
+so a warm state can be loaded again and again at low cost.
+*/
+
+//Section tags
+enum class CheckpointSection : std::uint32_t {
+    REPL = 1,
+    PHYSICAL = 2,
+    BUDDY = 3,
+    CACHE = 4,
+    VIRTUAL = 5,
+    NUMA = 6,
+    DRAM = 7
+};
+
+class CheckpointWriter {
+public:
+    CheckpointWriter();
+
+    template <typename T>
+    void put(const T &value) {
+        static_assert(std::is_trivially_copyable<T>::value, "POD values only");
+        put_bytes(&value, sizeof(T));
+    }
+    void put_bytes(const void *data, std::size_t size);
+    void put_string(const std::string &value);
+    void begin_section(CheckpointSection section);
+
+    //Write the buffered image to a file, returns false on I/O failure
+    bool write_file(const std::string &path) const;
+
+private:
+    std::vector<unsigned char> buffer_;
+};
+
+class CheckpointReader {
+public:
+    CheckpointReader();
+    ~CheckpointReader();
+
+    CheckpointReader(const CheckpointReader &) = delete;
+    CheckpointReader &operator=(const CheckpointReader &) = delete;
+
+    //Map a checkpoint file and validate its header
+    bool open(const std::string &path);
+    void close();
+
+    template <typename T>
+    bool get(T &value) {
+        static_assert(std::is_trivially_copyable<T>::value, "POD values only");
+        return get_bytes(&value, sizeof(T));
+    }
+    bool get_bytes(void *data, std::size_t size);
+    bool get_string(std::string &value);
+    //Consume a section tag, returns false if the next tag differs
+    bool expect_section(CheckpointSection section);
+
+    //False once any read ran past the end or mismatched
+    bool ok() const { return !failed_; }
+
+private:
+    const unsigned char *data_;
+    std::size_t size_;
+    std::size_t pos_;
+    bool failed_;
+    bool mapped_;
+};
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef DRAM_H
+#define DRAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+#include "checkpoint.h"
+
+/*
+DRAM timing model behind the last cache level
+- channels x ranks x banks, every bank has one row buffer
+- Physical addresses are split into fields by a mapping scheme, most
+  significant field first, e.g. "RoRaBaChCo":
+      Ro = row, Ra = rank, Ba = bank, Ch = channel, Co = column
+  The 64 byte burst offset is always the lowest field
+- Page policy OPEN keeps a row open after an access, CLOSED precharges
+  right away (auto-precharge)
+- Every channel has a request queue; the scheduler is FR-FCFS (oldest
+  row hit among the requests whose bank is ready, else the oldest ready
+  request) or plain FCFS
+- Time is counted in memory clock cycles. Requests arrive gap cycles
+  apart; a full queue stalls arrivals until a request is issued
+
+Latency of a request = data transfer done - arrival:
+  row hit      tCL + tBURST
+  row empty    tRCD + tCL + tBURST
+  row conflict tRP + tRCD + tCL + tBURST
+plus queueing delay and data bus contention.
+*/
+
+enum class PagePolicy {
+    OPEN,
+    CLOSED
+};
+
+enum class DramScheduler {
+    FR_FCFS,
+    FCFS
+};
+
+//Row buffer state seen by a request
+enum class RowOutcome {
+    HIT,
+    EMPTY,
+    CONFLICT
+};
+
+class Dram {
+public:
+    static constexpr std::size_t BURST_BYTES = 64;
+
+    Dram();
+
+    //Initialize geometry (all counts powers of two), default mapping and timing
+    bool init(std::size_t channels, std::size_t ranks, std::size_t banks,
+              std::size_t row_bytes, std::size_t rows);
+    bool ready() const { return !channels_.empty(); }
+
+    //Configuration
+    //Scheme: Ro, Ra, Ba, Ch, Co each exactly once, most significant first
+    bool set_mapping(const std::string &scheme);
+    void set_policy(PagePolicy policy) { policy_ = policy; }
+    void set_scheduler(DramScheduler scheduler) { scheduler_ = scheduler; }
+    bool set_timing(std::uint32_t cl, std::uint32_t rcd, std::uint32_t rp, std::uint32_t burst);
+    bool set_queue(std::size_t depth, std::size_t gap);
+
+    //One request (a last level cache miss) at physical address paddr
+    void access(std::size_t paddr);
+    //Issue everything still queued
+    void drain();
+    //Outcome and latency of the most recently completed request
+    RowOutcome last_outcome() const { return last_outcome_; }
+    std::uint64_t last_latency() const { return last_latency_; }
+
+    //Close all rows, empty the queues and clear statistics
+    void reset();
+
+    //Output
+    void stats() const;
+    std::uint64_t requests() const { return requests_; }
+    double row_hit_rate() const;
+
+    //Checkpoint (queues must be drained first)
+    void save(CheckpointWriter &out) const;
+    bool load(CheckpointReader &in);
+
+private:
+    enum Field { ROW, RANK, BANK, CHANNEL, COLUMN, FIELDS };
+
+    struct Request {
+        std::uint64_t arrival;
+        std::size_t bank;      //index within the channel
+        std::size_t row;
+    };
+
+    struct Bank {
+        bool open;
+        std::size_t row;
+        std::uint64_t ready;   //earliest cycle of the next command
+        std::uint64_t conflicts;
+    };
+
+    struct Channel {
+        std::deque<Request> queue;
+        std::vector<Bank> banks;
+        std::uint64_t cmd_free;   //command bus
+        std::uint64_t bus_free;   //data bus
+    };
+
+    void decode(std::size_t paddr, std::size_t fields[FIELDS]) const;
+    //Issue the requests that can start by cycle limit (only the next one if force_one)
+    void issue_until(Channel &channel, std::uint64_t limit, bool force_one);
+    void service(Channel &channel, std::size_t index, std::uint64_t start);
+    //Index of the request to issue at cycle now, or queue size if none is ready
+    std::size_t pick(const Channel &channel, std::uint64_t now) const;
+    std::uint64_t ready_at(const Channel &channel, const Request &r) const;
+    std::string mapping_name() const;
+
+private:
+    std::vector<Channel> channels_;
+    std::size_t ranks_;
+    std::size_t banks_;
+    std::size_t row_bytes_;
+    std::size_t rows_;
+    //Fields, most significant first, and the bit width of each field
+    std::vector<Field> order_;
+    std::size_t bits_[FIELDS];
+    PagePolicy policy_;
+    DramScheduler scheduler_;
+    std::uint32_t t_cl_;
+    std::uint32_t t_rcd_;
+    std::uint32_t t_rp_;
+    std::uint32_t t_burst_;
+    std::size_t queue_depth_;
+    std::size_t gap_;
+    //Arrival clock of the next request
+    std::uint64_t clock_;
+
+    //Statistics
+    std::uint64_t requests_;
+    std::uint64_t row_hits_;
+    std::uint64_t row_empty_;
+    std::uint64_t row_conflicts_;
+    std::uint64_t reordered_;
+    std::uint64_t stalls_;
+    std::uint64_t total_latency_;
+    std::uint64_t max_latency_;
+    //Latency histogram, 1 cycle buckets, last bucket = overflow
+    std::vector<std::uint64_t> latency_hist_;
+    RowOutcome last_outcome_;
+    std::uint64_t last_latency_;
+};
+
+#endif
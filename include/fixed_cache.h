@@ -0,0 +1,140 @@
+#ifndef FIXED_CACHE_H
+#define FIXED_CACHE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+Compile-time specialized cache geometry
+- FixedCache<BlockSize, Sets, Ways> has the same set-associative FIFO
+  behaviour as Cache, but index/tag shifts and masks are constants and
+  each set is a flat array of Ways tags (ring buffer, oldest at head)
+- Empty ways hold an invalid tag, so a lookup is one fixed-length scan
+- A registry instantiates common geometries behind the CacheKernel
+  interface; Cache uses one when its geometry is registered and keeps
+  its runtime deque sets for anything else
+*/
+
+//Contents of a cache, shared interface of the specialized geometries
+class CacheKernel {
+public:
+    virtual ~CacheKernel() {}
+    //Lookup, fill on miss (FIFO), true on hit
+    //evicted_tag (if given) receives the tag of a replaced line
+    virtual bool lookup_fill(std::size_t address, std::size_t *evicted_tag) = 0;
+    virtual void clear() = 0;
+    //Tags of one set, oldest first (dump and checkpoints)
+    virtual void set_lines(std::size_t set, std::vector<std::size_t> &tags) const = 0;
+    virtual void load_set(std::size_t set, const std::vector<std::size_t> &tags) = 0;
+};
+
+constexpr std::size_t log2_constant(std::size_t x) {
+    return (x <= 1) ? 0 : 1 + log2_constant(x / 2);
+}
+
+template <std::size_t BlockSize, std::size_t Sets, std::size_t Ways>
+class FixedCache {
+    static_assert(BlockSize > 0 && (BlockSize & (BlockSize - 1)) == 0, "block size must be a power of two");
+    static_assert(Sets > 0 && (Sets & (Sets - 1)) == 0, "set count must be a power of two");
+    static_assert(Ways > 0 && (Ways & (Ways - 1)) == 0, "ways must be a power of two");
+
+public:
+    static constexpr std::size_t OFFSET_BITS = log2_constant(BlockSize);
+    static constexpr std::size_t INDEX_BITS = log2_constant(Sets);
+    //tags are shifted addresses, so all ones never occurs
+    static constexpr std::size_t INVALID_TAG = ~std::size_t(0);
+
+    FixedCache() : tags_(Sets * Ways, INVALID_TAG), head_(Sets, 0), count_(Sets, 0), hits_(0), misses_(0) {}
+
+    bool lookup_fill(std::size_t address, std::size_t *evicted_tag = nullptr) {
+        std::size_t set = (address >> OFFSET_BITS) & (Sets - 1);
+        std::size_t tag = address >> (OFFSET_BITS + INDEX_BITS);
+        std::size_t *lines = &tags_[set * Ways];
+
+        for (std::size_t w = 0; w < Ways; w++) {
+            if (lines[w] == tag)
+                return true;
+        }
+
+        //fill the next empty way, or replace the oldest one
+        if (count_[set] < Ways) {
+            lines[(head_[set] + count_[set]) & (Ways - 1)] = tag;
+            count_[set]++;
+        } else {
+            if (evicted_tag)
+                *evicted_tag = lines[head_[set]];
+            lines[head_[set]] = tag;
+            head_[set] = (head_[set] + 1) & (Ways - 1);
+        }
+        return false;
+    }
+
+    bool access(std::size_t address) {
+        if (lookup_fill(address)) {
+            hits_++;
+            return true;
+        }
+        misses_++;
+        return false;
+    }
+
+    void clear() {
+        std::fill(tags_.begin(), tags_.end(), INVALID_TAG);
+        std::fill(head_.begin(), head_.end(), 0);
+        std::fill(count_.begin(), count_.end(), 0);
+        hits_ = 0;
+        misses_ = 0;
+    }
+
+    void set_lines(std::size_t set, std::vector<std::size_t> &tags) const {
+        tags.clear();
+        for (std::uint32_t i = 0; i < count_[set]; i++)
+            tags.push_back(tags_[set * Ways + ((head_[set] + i) & (Ways - 1))]);
+    }
+
+    void load_set(std::size_t set, const std::vector<std::size_t> &tags) {
+        std::size_t *lines = &tags_[set * Ways];
+        std::fill(lines, lines + Ways, INVALID_TAG);
+        head_[set] = 0;
+        count_[set] = 0;
+        for (std::size_t i = 0; i < tags.size() && i < Ways; i++) {
+            lines[i] = tags[i];
+            count_[set]++;
+        }
+    }
+
+    std::size_t hits() const { return hits_; }
+    std::size_t misses() const { return misses_; }
+
+private:
+    std::vector<std::size_t> tags_;
+    std::vector<std::uint32_t> head_;
+    std::vector<std::uint32_t> count_;
+    std::size_t hits_;
+    std::size_t misses_;
+};
+
+template <std::size_t BlockSize, std::size_t Sets, std::size_t Ways>
+class FixedCacheKernel : public CacheKernel {
+public:
+    bool lookup_fill(std::size_t address, std::size_t *evicted_tag) override {
+        return cache_.lookup_fill(address, evicted_tag);
+    }
+    void clear() override { cache_.clear(); }
+    void set_lines(std::size_t set, std::vector<std::size_t> &tags) const override { cache_.set_lines(set, tags); }
+    void load_set(std::size_t set, const std::vector<std::size_t> &tags) override { cache_.load_set(set, tags); }
+
+private:
+    FixedCache<BlockSize, Sets, Ways> cache_;
+};
+
+//Specialized kernel for a registered geometry, nullptr otherwise
+std::unique_ptr<CacheKernel> make_cache_kernel(std::size_t block_size, std::size_t sets, std::size_t ways);
+
+//Print the registered geometries
+void list_cache_kernels();
+
+#endif
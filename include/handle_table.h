@@ -0,0 +1,167 @@
+#ifndef HANDLE_TABLE_H
+#define HANDLE_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "checkpoint.h"
+
+/*
+Dense slot table with generation-tagged handles
+- Live values are stored in a contiguous vector of slots
+- Freed slots are recycled through an intrusive free list
+- Every recycle bumps the slot generation, so stale handles are rejected
+
+Handle format (64 bit):
+| GENERATION (32) | SLOT INDEX (32) |
+
+Slot 0 is never used, so handle 0 is always invalid and a fresh table
+hands out 1, 2, 3, ... until slots start being recycled.
+*/
+
+using AllocId = std::uint64_t;
+constexpr AllocId INVALID_ID = 0;
+
+template <typename T>
+class HandleTable {
+public:
+    HandleTable() : slots_(1), free_head_(0), live_(0) {}
+
+    //Store a value, returns its handle
+    AllocId insert(const T &value) {
+        std::uint32_t index;
+        if (free_head_ != 0) {
+            index = free_head_;
+            free_head_ = slots_[index].next_free;
+        } else {
+            index = static_cast<std::uint32_t>(slots_.size());
+            slots_.emplace_back();
+        }
+
+        Slot &slot = slots_[index];
+        slot.value = value;
+        slot.live = true;
+        live_++;
+        return make_handle(slot.generation, index);
+    }
+
+    //O(1) lookup, nullptr for invalid or stale handles
+    T *find(AllocId id) {
+        Slot *slot = slot_of(id);
+        return slot ? &slot->value : nullptr;
+    }
+    const T *find(AllocId id) const {
+        return const_cast<HandleTable *>(this)->find(id);
+    }
+
+    //Release a handle, returns false for invalid, stale or double frees
+    bool erase(AllocId id) {
+        Slot *slot = slot_of(id);
+        if (!slot)
+            return false;
+
+        slot->live = false;
+        slot->value = T();
+        live_--;
+
+        //a slot whose generation would wrap is retired instead of recycled
+        if (slot->generation == UINT32_MAX)
+            return true;
+
+        slot->generation++;
+        std::uint32_t index = static_cast<std::uint32_t>(id & 0xffffffffu);
+        slot->next_free = free_head_;
+        free_head_ = index;
+        return true;
+    }
+
+    void clear() {
+        slots_.assign(1, Slot());
+        free_head_ = 0;
+        live_ = 0;
+    }
+
+    //Number of live handles
+    std::size_t size() const { return live_; }
+    //Number of slots (high-water mark of live handles)
+    std::size_t capacity() const { return slots_.size() - 1; }
+
+    //Visit every live (handle, value) pair in slot order
+    template <typename F>
+    void for_each(F fn) const {
+        for (std::size_t i = 1; i < slots_.size(); i++) {
+            if (slots_[i].live)
+                fn(make_handle(slots_[i].generation, static_cast<std::uint32_t>(i)),
+                   slots_[i].value);
+        }
+    }
+
+    //Checkpoint support: slot metadata is stored exactly, so ids handed out
+    //after a restore match the original run. Values go through the callbacks.
+    template <typename W>
+    void save(CheckpointWriter &out, W write_value) const {
+        out.put(static_cast<std::uint64_t>(slots_.size()));
+        out.put(free_head_);
+        for (std::size_t i = 1; i < slots_.size(); i++) {
+            out.put(slots_[i].generation);
+            out.put(slots_[i].next_free);
+            out.put(static_cast<std::uint8_t>(slots_[i].live));
+            if (slots_[i].live)
+                write_value(out, slots_[i].value);
+        }
+    }
+
+    template <typename R>
+    bool load(CheckpointReader &in, R read_value) {
+        std::uint64_t count = 0;
+        if (!in.get(count) || count == 0 || !in.get(free_head_))
+            return false;
+
+        slots_.assign(1, Slot());
+        live_ = 0;
+        for (std::uint64_t i = 1; i < count; i++) {
+            Slot slot;
+            std::uint8_t live = 0;
+            if (!in.get(slot.generation) || !in.get(slot.next_free) || !in.get(live))
+                return false;
+            slot.live = live != 0;
+            if (slot.live) {
+                if (!read_value(in, slot.value))
+                    return false;
+                live_++;
+            }
+            slots_.push_back(slot);
+        }
+        return free_head_ < slots_.size();
+    }
+
+private:
+    struct Slot {
+        T value{};
+        std::uint32_t generation = 0;
+        std::uint32_t next_free = 0;
+        bool live = false;
+    };
+
+    static AllocId make_handle(std::uint32_t generation, std::uint32_t index) {
+        return (static_cast<AllocId>(generation) << 32) | index;
+    }
+
+    Slot *slot_of(AllocId id) {
+        std::uint32_t index = static_cast<std::uint32_t>(id & 0xffffffffu);
+        std::uint32_t generation = static_cast<std::uint32_t>(id >> 32);
+        if (index == 0 || index >= slots_.size())
+            return nullptr;
+        Slot &slot = slots_[index];
+        if (!slot.live || slot.generation != generation)
+            return nullptr;
+        return &slot;
+    }
+
+private:
+    std::vector<Slot> slots_;
+    std::uint32_t free_head_;
+    std::size_t live_;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+#include "physical_memory.h"
+#include "buddy_allocator.h"
+#include "handle_table.h"
+
+/*
+NUMA-aware physical memory
+- Memory is split into equally sized nodes (sockets)
+- Every node has its own allocator instances
+- Node n owns physical addresses [n * node_size, (n + 1) * node_size)
+- The simulated thread runs on one "cpu node"; accesses to memory on
+  another node are remote and pay a higher latency
+
+Placement policies (allocations and VM page-ins):
+- LOCAL:       cpu node, falling back to the other nodes
+- INTERLEAVE:  round robin over all nodes
+- PREFERRED:   a fixed node, falling back to the other nodes
+- FIRST_TOUCH: node of the cpu that touches a page first, kept for the
+               page's lifetime even across evictions
+*/
+
+enum class NumaPolicy {
+    LOCAL,
+    INTERLEAVE,
+    PREFERRED,
+    FIRST_TOUCH
+};
+
+//Allocator used inside every node
+enum class NumaEngine {
+    PHYSICAL,
+    BUDDY
+};
+
+class NumaMemory {
+public:
+    NumaMemory();
+
+    //Initialize num_nodes nodes of node_size bytes each
+    bool init(std::size_t num_nodes, std::size_t node_size);
+    bool ready() const { return !nodes_.empty(); }
+
+    //Configuration
+    void set_policy(NumaPolicy policy, std::size_t preferred_node = 0);
+    bool set_engine(NumaEngine engine, AllocatorType type);
+    bool set_cpu_node(std::size_t node);
+    void set_latency(std::size_t local, std::size_t remote);
+
+    //Allocation interface (addresses are global physical addresses)
+    AllocId malloc(std::size_t size);
+    bool free_block(AllocId id);
+    bool address_of(AllocId id, std::size_t &address) const;
+    //Alignment holds for global addresses when node_size is a multiple of it
+    AllocId malloc_aligned(std::size_t size, std::size_t alignment);
+    //Resize within the block's node (the id stays valid)
+    bool realloc(AllocId id, std::size_t size);
+
+    //Allocate a page frame for a faulting virtual page on the node chosen
+    //by the placement policy, falling back to the other nodes when it is full;
+    //size is the page size (a power of two) and the frame is aligned to it
+    AllocId malloc_page(std::size_t vpage, std::size_t size);
+
+    //Node that owns a physical address
+    std::size_t node_of(std::size_t paddr) const;
+    //Node a faulting virtual page is placed on
+    std::size_t place_page(std::size_t vpage);
+    //Node a resident virtual page was placed on
+    std::size_t page_node(std::size_t vpage) const;
+
+    //Charge one memory access to node, returns its latency
+    std::size_t charge_access(std::size_t node);
+
+    //Output
+    void dump() const;
+    void stats() const;
+    double utilization() const;
+    double external_fragmentation() const;
+    std::size_t alloc_requests() const;
+    std::size_t failed_allocs() const;
+
+    //Checkpoint
+    void save(CheckpointWriter &out) const;
+    bool load(CheckpointReader &in);
+
+private:
+    struct Node {
+        PhysicalMemory phys;
+        BuddyAllocator buddy;
+        std::size_t allocations = 0;
+        std::size_t pages = 0;
+        std::size_t local_accesses = 0;
+        std::size_t remote_accesses = 0;
+    };
+
+    //Node order to try for one placement decision
+    std::vector<std::size_t> placement_order(std::size_t first) const;
+    std::size_t policy_node();
+    AllocId node_malloc(std::size_t node, std::size_t size, std::size_t alignment = 1);
+    bool node_free(std::size_t node, AllocId id);
+
+private:
+    std::vector<Node> nodes_;
+    std::size_t node_size_;
+    NumaPolicy policy_;
+    NumaEngine engine_;
+    AllocatorType allocator_;
+    std::size_t preferred_node_;
+    std::size_t cpu_node_;
+    std::size_t interleave_next_;
+    std::size_t local_latency_;
+    std::size_t remote_latency_;
+    std::size_t total_latency_;
+
+    //id -> (node, id inside the node allocator)
+    HandleTable<std::pair<std::size_t, AllocId>> ids_;
+    //virtual page -> node (first-touch nodes persist across evictions)
+    std::unordered_map<std::size_t, std::size_t> page_nodes_;
+};
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef PAGE_TRACKER_H
+#define PAGE_TRACKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "checkpoint.h"
+
+/*
+Working set and page heat tracking for the virtual memory
+- Every reference sets the page's accessed bit (one byte store)
+- Every scan_interval references a scanner walks all pages, like Linux
+  idle page tracking: accessed pages get idle age 0 and their bit is
+  cleared, the others age by one scan
+- WSS is recorded once per scan:
+    EXACT:   distinct pages among the last window references
+             (ring buffer of references + per-page counts)
+    SAMPLED: pages accessed within the last window / scan_interval scans,
+             no per-reference work beyond the accessed bit
+- Heat per page: references (EXACT) or scans the page was accessed in (SAMPLED)
+- Idle ages are kept per page in scans, histogrammed in power of two buckets
+
+Export writes CSV files for plotting: <prefix>_wss.csv, <prefix>_heat.csv
+and <prefix>_idle.csv. The WSS series keeps the last WSS_HISTORY scans;
+current, average and max cover all of them.
+*/
+
+enum class TrackMode {
+    EXACT,
+    SAMPLED
+};
+
+class PageTracker {
+public:
+    //Scans kept for the WSS export
+    static constexpr std::size_t WSS_HISTORY = 65536;
+
+    PageTracker();
+
+    //Track pages [0, pages), false on an invalid window or interval
+    bool start(TrackMode mode, std::size_t pages, std::size_t window, std::size_t scan_interval);
+    void stop();
+    bool enabled() const { return enabled_; }
+
+    //Hot path: one reference to page (page < pages)
+    void reference(std::size_t page) {
+        if (!enabled_)
+            return;
+        accessed_[page] = 1;
+        if (mode_ == TrackMode::EXACT)
+            exact_reference(page);
+        if (--countdown_ == 0)
+            scan();
+    }
+
+    //Forget all history, keep the configuration
+    void clear();
+
+    //Output
+    void stats(std::size_t page_size) const;
+    //Text heatmap, columns pages per row (pages folded into cells when many)
+    void heatmap(std::size_t columns) const;
+    //CSV export, false if a file cannot be written
+    bool export_csv(const std::string &prefix) const;
+
+    //Checkpoint
+    void save(CheckpointWriter &out) const;
+    bool load(CheckpointReader &in);
+
+private:
+    void exact_reference(std::size_t page);
+    void scan();
+    //Histogram bucket of an idle age: 0, 1, 2-3, 4-7, ...
+    static std::size_t age_bucket(std::uint32_t age);
+    void record_wss(std::uint32_t wss);
+
+private:
+    bool enabled_;
+    TrackMode mode_;
+    std::size_t window_;
+    std::size_t scan_interval_;
+    std::size_t countdown_;
+    std::uint64_t references_;
+    std::uint64_t scans_;
+
+    //Per page
+    std::vector<std::uint8_t> accessed_;
+    std::vector<std::uint64_t> heat_;
+    std::vector<std::uint32_t> age_;     //scans since last access, NEVER if untouched
+
+    //EXACT sliding window
+    std::vector<std::size_t> ring_;
+    std::size_t ring_pos_;
+    std::size_t ring_fill_;
+    std::vector<std::uint32_t> window_count_;
+    std::size_t distinct_;
+
+    //WSS (pages) over all scans, and a ring of the last WSS_HISTORY
+    std::uint32_t wss_current_;
+    std::uint32_t wss_max_;
+    std::uint64_t wss_sum_;
+    std::vector<std::uint32_t> wss_history_;
+    std::size_t wss_pos_;   //oldest entry once the ring is full
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+Hardware performance counter instrumentation (Linux perf_event_open)
+- Measures how fast the simulator itself runs, not what it simulates
+- Counters: cycles, instructions, LLC misses, branch misses + wall time
+- Counters are read in user space with rdpmc where the kernel allows it,
+  otherwise with read() on the event fd
+- Without perf_event access only wall time is reported
+
+Enabled at build time with: make PERF=1
+Without MEMSIM_PERF every PERF_SCOPE compiles to nothing.
+*/
+
+//Instrumented hot paths
+enum class PerfComponent {
+    CACHE_ACCESS,
+    VM_ACCESS,
+    PHYS_MALLOC,
+    PHYS_FREE,
+    BUDDY_MALLOC,
+    BUDDY_FREE,
+    COUNT
+};
+
+//Counter values at one point in time
+struct PerfSample {
+    std::uint64_t ns;
+    std::uint64_t cycles;
+    std::uint64_t instructions;
+    std::uint64_t llc_misses;
+    std::uint64_t branch_misses;
+};
+
+//RAII timer: accumulates counter deltas for one component
+class PerfScope {
+public:
+    explicit PerfScope(PerfComponent component);
+    ~PerfScope();
+
+    PerfScope(const PerfScope &) = delete;
+    PerfScope &operator=(const PerfScope &) = delete;
+
+private:
+    PerfComponent component_;
+    PerfSample start_;
+};
+
+//Print IPC and ns/op per component
+void perf_report();
+
+#ifdef MEMSIM_PERF
+constexpr bool PERF_INSTRUMENTED = true;
+#define PERF_SCOPE(component) PerfScope perf_scope_(PerfComponent::component)
+#else
+constexpr bool PERF_INSTRUMENTED = false;
+#define PERF_SCOPE(component) do {} while (0)
+#endif
+
+#endif
@@ -2,7 +2,9 @@
 #define PHYSICAL_MEMORY_H
 
 #include <list>
+#include <vector>
 #include <cstddef>
+#include "handle_table.h"
 
 // Allocation strategy 
 enum class AllocatorType {
@@ -11,15 +13,23 @@ enum class AllocatorType {
     WORST_FIT
 };
 
+// Compaction policy
+enum class CompactionPolicy {
+    OFF,        //never compact automatically
+    ON_FAILURE, //compact when an allocation fails due to fragmentation
+    THRESHOLD   //also compact after a free once fragmentation exceeds a threshold
+};
+
 // Memory block representation 
 struct Block {
     std::size_t start;  //starting address
     std::size_t size;//size in bytes
     bool free;
-    int id;  // block id, -1 if free
+    AllocId id;  // block id, INVALID_ID if free
+    std::size_t alignment;  //alignment promised at allocation, kept by compaction and realloc
 
-    Block(std::size_t s, std::size_t sz, bool f, int i)
-        : start(s), size(sz), free(f), id(i) {}
+    Block(std::size_t s, std::size_t sz, bool f, AllocId i, std::size_t a = 1)
+        : start(s), size(sz), free(f), id(i), alignment(a) {}
 };
 
 //Physical memory simulator 
@@ -27,15 +37,44 @@ class PhysicalMemory {
 public:
     PhysicalMemory();
 
+    //ids_ holds iterators into blocks_, so copies would alias the source
+    PhysicalMemory(const PhysicalMemory &) = delete;
+    PhysicalMemory &operator=(const PhysicalMemory &) = delete;
+    PhysicalMemory(PhysicalMemory &&) = default;
+    PhysicalMemory &operator=(PhysicalMemory &&) = default;
+
     void init(std::size_t total_size);
     void dump() const;
     //allocation interface
-    int malloc(std::size_t size);
-    bool free_block(int id);
+    AllocId malloc(std::size_t size);
+    bool free_block(AllocId id);
+    //alignment must be a power of two; the padding in front stays a free hole
+    AllocId malloc_aligned(std::size_t size, std::size_t alignment);
+    //resize, growing into a free right neighbour when possible, otherwise
+    //moving the block; the id stays valid, false leaves the block unchanged
+    bool realloc(AllocId id, std::size_t size);
+    //batch interface: ids[i] answers sizes[i] (INVALID_ID on failure),
+    //returns the number of successful requests
+    std::size_t malloc_batch(const std::vector<std::size_t> &sizes, std::vector<AllocId> &ids);
+    std::size_t free_batch(const std::vector<AllocId> &ids);
+    //look up the start address of an allocated block
+    bool address_of(AllocId id, std::size_t &address) const;
     //allocator control
     void set_allocator(AllocatorType type);
+    //compaction control
+    void set_compaction(CompactionPolicy policy, double threshold = 0.5);
+    //slide all used blocks to the start of memory, returns bytes moved
+    std::size_t compact();
     //statistics
     void stats() const;
+    double utilization() const;
+    double external_fragmentation() const;
+    std::size_t alloc_requests() const { return total_alloc_requests_; }
+    std::size_t failed_allocs() const { return failed_allocs_; }
+    std::size_t total_size() const { return total_size_; }
+    //checkpoint
+    void save(CheckpointWriter &out) const;
+    bool load(CheckpointReader &in);
 
 private:
     
@@ -43,19 +82,51 @@ private:
     std::size_t total_alloc_requests_;
     std::size_t successful_allocs_;
     std::size_t failed_allocs_;
+    std::size_t invalid_frees_;
 
     std::size_t total_size_;
     std::list<Block> blocks_;
-    int next_id_;
+    //id -> allocated block (list iterators stay valid across split/merge)
+    HandleTable<std::list<Block>::iterator> ids_;
     AllocatorType allocator_;
 
-    // allocation strategies
-    int malloc_first_fit(std::size_t size);
-    int malloc_best_fit(std::size_t size);
-    int malloc_worst_fit(std::size_t size);
+    //compaction configuration and cost accounting
+    CompactionPolicy compaction_;
+    double compaction_threshold_;
+    std::size_t compactions_;
+    std::size_t bytes_moved_;
+    std::size_t blocks_moved_;
+    std::size_t rescued_allocs_;
+
+    //aligned, realloc and batch accounting
+    std::size_t aligned_allocs_;
+    std::size_t reallocs_;
+    std::size_t reallocs_in_place_;
+    std::size_t realloc_bytes_copied_;
+    std::size_t batches_;
+    std::size_t batched_requests_;
+
+    // allocation strategies, blocks_.end() if no hole fits
+    std::list<Block>::iterator find_first_fit(std::size_t size, std::size_t alignment);
+    std::list<Block>::iterator find_best_fit(std::size_t size, std::size_t alignment);
+    std::list<Block>::iterator find_worst_fit(std::size_t size, std::size_t alignment);
+    std::list<Block>::iterator find_hole(std::size_t size, std::size_t alignment);
+
+    //shared allocation helpers
+    AllocId allocate_request(std::size_t size, std::size_t alignment);
+    AllocId allocate_from_block(std::list<Block>::iterator it, std::size_t size, std::size_t alignment = 1);
+    AllocId allocate_with_strategy(std::size_t size, std::size_t alignment = 1);
+    //split the hole and mark the block used, without an id
+    std::list<Block>::iterator carve(std::list<Block>::iterator it, std::size_t size, std::size_t alignment);
+    //bytes in front of blk before an aligned start, SIZE_MAX if size does not fit
+    static std::size_t fit_padding(const Block &blk, std::size_t size, std::size_t alignment);
+
+    //free helpers: release coalesces with free neighbours
+    void release(std::list<Block>::iterator it);
+    void compact_if_fragmented();
 
-    //shared allocation helper
-    int allocate_from_block(std::list<Block>::iterator it, std::size_t size);
+    //fragmentation helper
+    std::size_t largest_free_block() const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,87 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+Sampled simulation (SMARTS style periodic sampling)
+Every period of the reference stream is split into three phases:
+
+| FAST-FORWARD | WARM-UP | DETAILED |
+
+- FAST-FORWARD: functional warming only (cache and page state updated,
+  no statistics, no output), or skipped entirely
+- WARM-UP: full simulation, statistics discarded
+- DETAILED: full simulation, one measurement window
+
+Hit and fault rates are estimated from the detailed windows and reported
+with 95% confidence intervals, then extrapolated to the whole stream.
+*/
+
+enum class SamplePhase {
+    FAST_FORWARD,
+    WARMUP,
+    DETAIL
+};
+
+//Cumulative counters the sampler takes window deltas from
+struct SampleCounters {
+    std::size_t l1_hits;
+    std::size_t l1_misses;
+    std::size_t l2_hits;
+    std::size_t l2_misses;
+    std::size_t page_hits;
+    std::size_t page_faults;
+};
+
+class Sampler {
+public:
+    Sampler();
+
+    //Configure phase lengths (in references), returns false if detail is 0
+    bool init(std::uint64_t fast_forward, std::uint64_t warmup, std::uint64_t detail,
+              bool functional_warming);
+    void disable() { enabled_ = false; }
+    bool enabled() const { return enabled_; }
+    bool functional_warming() const { return functional_warming_; }
+
+    //Phase of the next reference, takes the window baseline when a window opens
+    SamplePhase begin_reference(const SampleCounters &now);
+    //Close the reference, records a window sample when a window ends
+    void end_reference(const SampleCounters &now);
+
+    //Print estimates with confidence intervals
+    void report() const;
+
+private:
+    //Running sums of one per-window ratio, enough for the mean and the
+    //confidence interval; windows with no events are skipped
+    struct RatioSum {
+        std::uint64_t samples = 0;
+        std::uint64_t skipped = 0;
+        double sum = 0.0;
+        double sum_sq = 0.0;
+
+        void add(std::size_t part, std::size_t other);
+    };
+
+    std::uint64_t period() const { return fast_forward_ + warmup_ + detail_; }
+
+private:
+    bool enabled_;
+    bool functional_warming_;
+    std::uint64_t fast_forward_;
+    std::uint64_t warmup_;
+    std::uint64_t detail_;
+
+    std::uint64_t references_;
+    std::uint64_t detailed_references_;
+    SampleCounters baseline_;
+    std::uint64_t windows_;
+    RatioSum l1_hit_rate_;
+    RatioSum l2_hit_rate_;
+    RatioSum fault_rate_;
+};
+
+#endif
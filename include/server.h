@@ -0,0 +1,132 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "simulator.h"
+
+/*
+Daemon mode: memsim --serve <socket path>
+- One epoll loop on a Unix domain stream socket, clients are non-blocking
+- Named sessions, each a full Simulator (allocators, caches, VM, ...),
+  created by the first frame that names them and shared by all clients;
+  a COMMAND "exit" closes the session
+- Clients pipeline frames without waiting: every complete frame in the
+  read buffer runs in order, the replies are queued and written in bulk
+
+Frame (host byte order, the socket is local):
+| BYTES (4) | REQUESTS (4) | NAME LENGTH (2) | unused (2) | SESSION NAME | REQUEST | ... |
+BYTES counts everything after the 12 byte header.
+REQUEST (24 bytes):
+| OP (1) | ACCESS TYPE (1) | unused (2) | STREAM (4) | VALUE (8) | ARG (8) |
+OP is a TraceOp with the same value and arg, or COMMAND: VALUE is the
+length of a REPL command line that follows the request.
+
+Reply frame, one REPLY per request in order:
+| BYTES (4) | REPLIES (4) | REPLY | ... |
+REPLY (16 bytes):
+| STATUS (1) | SERVED BY (1) | unused (2) | TEXT LENGTH (4) | VALUE (8) |
+VALUE: MALLOC/MALLOC_ALIGNED the id, FREE the id freed, REALLOC the new
+address, ACCESS/VACCESS the physical address, BATCH the requests done.
+COMMAND replies carry the command's output as text.
+*/
+
+//Request op of a REPL command line, next to the TraceOps
+constexpr std::uint8_t COMMAND_OP = 0x80;
+
+enum class ReplyStatus : std::uint8_t {
+    OK,
+    FAILED,      //allocation failed, unknown ordinal or reference skipped
+    BAD_REQUEST  //unknown op
+};
+
+#pragma pack(push, 1)
+struct FrameHeader {
+    std::uint32_t bytes;
+    std::uint32_t requests;
+    std::uint16_t name_length;
+    std::uint16_t unused;
+};
+
+struct WireRequest {
+    std::uint8_t op;
+    std::uint8_t type;
+    std::uint16_t unused;
+    std::uint32_t stream;
+    std::uint64_t value;
+    std::uint64_t arg;
+};
+
+struct ReplyHeader {
+    std::uint32_t bytes;
+    std::uint32_t replies;
+};
+
+struct WireReply {
+    std::uint8_t status;
+    std::uint8_t served;
+    std::uint16_t unused;
+    std::uint32_t text_length;
+    std::uint64_t value;
+};
+#pragma pack(pop)
+
+class Server {
+public:
+    //Largest frame accepted, a client sending more is disconnected
+    static constexpr std::size_t MAX_FRAME = 64 << 20;
+
+    Server();
+    ~Server();
+
+    Server(const Server &) = delete;
+    Server &operator=(const Server &) = delete;
+
+    //Bind and listen (a stale socket file is replaced), false on failure
+    bool listen(const std::string &path);
+    //Event loop until SIGINT/SIGTERM, then the socket file is removed
+    void run();
+
+private:
+    struct Client {
+        std::vector<char> in;
+        std::size_t in_used = 0;
+        std::vector<char> out;
+        std::size_t out_sent = 0;
+        std::uint32_t events = 0;   //epoll interest
+        bool closing = false;       //peer shut down its side
+    };
+
+    void accept_clients();
+    //Read what is available, false to drop the client
+    bool read_client(int fd, Client &client);
+    //Serve every complete frame while the reply backlog is small, false on a bad frame
+    bool serve_frames(Client &client);
+    //Run one frame, append its reply to client.out
+    bool serve_frame(const char *frame, std::size_t size, Client &client);
+    //Send queued replies, false to drop the client
+    bool write_client(int fd, Client &client);
+    //Serve and write until neither makes progress, false to drop the client
+    bool pump(int fd, Client &client);
+    //Read only while the reply backlog is small, write while there is one
+    void update_events(int fd, Client &client);
+    void drop_client(int fd);
+    Simulator &session(const std::string &name);
+
+private:
+    int listen_fd_;
+    int epoll_fd_;
+    std::string path_;
+    std::map<int, Client> clients_;
+    std::map<std::string, std::unique_ptr<Simulator>> sessions_;
+
+    //Statistics
+    std::uint64_t frames_;
+    std::uint64_t requests_;
+};
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "physical_memory.h"
+#include "buddy_allocator.h"
+#include "cache.h"
+#include "virtual_memory.h"
+#include "numa.h"
+#include "dram.h"
+#include "telemetry.h"
+#include "sampler.h"
+#include "trace.h"
+
+/*
+One simulator session: allocators, caches, VM, NUMA and DRAM with the
+REPL command set on top. The interactive REPL runs one session; the
+daemon (server.h) hosts many named ones.
+*/
+
+enum class ActiveAllocator {
+    PHYSICAL,
+    BUDDY,
+    NUMA
+};
+
+//Where a reference was served
+enum class ServedBy : std::uint8_t {
+    SKIPPED,   //caches or VM not initialized
+    L1,
+    L2,
+    MEMORY,
+    SAMPLED    //sampling mode decides per phase, no outcome
+};
+
+//Answer to one daemon request
+struct RecordResult {
+    bool ok;
+    ServedBy served;
+    std::uint64_t value;   //id, physical address or count, see server.h
+};
+
+//Outcome of one trace replay, or of a daemon session's requests
+struct ReplayCounts {
+    std::vector<AllocId> ids;  //MALLOC ordinal -> id handed out by the active allocator
+    std::uint64_t records = 0;
+    std::uint64_t failed = 0;
+    std::uint64_t bad_frees = 0;
+    std::uint64_t skipped = 0;
+    //records of the BATCH being collected, and how many are still to come
+    std::vector<TraceRecord> batch;
+    std::uint64_t batch_left = 0;
+    //Daemon only: one answer per record of the current call (null when
+    //replaying a trace), and the slots of the BATCH and its records
+    std::vector<RecordResult> *results = nullptr;
+    std::size_t batch_slot = 0;
+    std::vector<std::size_t> batch_slots;
+};
+
+//Page frames for the virtual memory, taken from one of the allocators
+class AllocatorFrames : public FrameProvider {
+public:
+    AllocatorFrames(PhysicalMemory &phys, BuddyAllocator &buddy, NumaMemory &numa)
+        : phys_(phys), buddy_(buddy), numa_(numa), source_(ActiveAllocator::PHYSICAL) {}
+
+    void set_source(ActiveAllocator source) { source_ = source; }
+    ActiveAllocator source() const { return source_; }
+
+    AllocId allocate_frame(std::size_t page_size, std::size_t vpage) override {
+        switch (source_) {
+            //page sizes are powers of two, buddy blocks are naturally aligned
+            case ActiveAllocator::PHYSICAL: return phys_.malloc_aligned(page_size, page_size);
+            case ActiveAllocator::BUDDY:    return buddy_.malloc_zone(page_size, ZoneType::MOVABLE);
+            case ActiveAllocator::NUMA:     return numa_.malloc_page(vpage, page_size);
+        }
+        return INVALID_ID;
+    }
+
+    void release_frame(AllocId frame) override {
+        switch (source_) {
+            case ActiveAllocator::PHYSICAL: phys_.free_block(frame); break;
+            case ActiveAllocator::BUDDY:    buddy_.free_block(frame); break;
+            case ActiveAllocator::NUMA:     numa_.free_block(frame); break;
+        }
+    }
+
+    bool frame_address(AllocId frame, std::size_t &address) const override {
+        switch (source_) {
+            case ActiveAllocator::PHYSICAL: return phys_.address_of(frame, address);
+            case ActiveAllocator::BUDDY:    return buddy_.address_of(frame, address);
+            case ActiveAllocator::NUMA:     return numa_.address_of(frame, address);
+        }
+        return false;
+    }
+
+private:
+    PhysicalMemory &phys_;
+    BuddyAllocator &buddy_;
+    NumaMemory &numa_;
+    ActiveAllocator source_;
+};
+
+class Simulator {
+public:
+    Simulator();
+    ~Simulator();
+
+    //the frame provider points into the session
+    Simulator(const Simulator &) = delete;
+    Simulator &operator=(const Simulator &) = delete;
+
+    //Run one REPL command line, output goes to std::cout; false on exit
+    bool execute(const std::string &line);
+
+    //Daemon requests: records[i] is answered by results[i]. The records
+    //run exactly like a trace replay: FREE and REALLOC name a MALLOC by
+    //its ordinal among the session's requests, so a client never waits for
+    //an id, and BATCH n groups the next n MALLOC or FREE records of the
+    //same call into one batch (the end of a call cuts it short).
+    void apply(const std::vector<TraceRecord> &records, std::vector<RecordResult> &results);
+
+private:
+    //Drop resident pages whose frames live in an allocator that is being reset
+    void drop_frames_from(ActiveAllocator source);
+    //metrics of all components, for telemetry export
+    TelemetrySnapshot snapshot() const;
+    std::size_t translate(std::size_t vaddr, bool warm);
+    std::string charge_memory(std::size_t address, std::size_t paddr, bool is_virtual, bool wait);
+
+    //True if id is a page frame the VM holds in the active allocator
+    bool vm_frame(AllocId id) const;
+    //Allocation through the active allocator, VM frames are never freed or resized
+    AllocId allocate(std::size_t size);
+    bool release(AllocId id);
+    AllocId allocate_aligned(std::size_t size, std::size_t alignment);
+    bool resize(AllocId id, std::size_t size);
+    bool locate(AllocId id, std::size_t &address) const;
+    std::size_t allocate_batch(const std::vector<std::size_t> &sizes, std::vector<AllocId> &ids);
+    std::size_t release_batch(const std::vector<AllocId> &ids);
+
+    SampleCounters sample_counters() const;
+    void sampled_reference(std::size_t address, bool is_virtual, AccessType type);
+    //One ACCESS or VACCESS record without output, paddr = translated address
+    ServedBy reference(const TraceRecord &r, std::size_t &paddr);
+
+    void replay_batch(ReplayCounts &counts);
+    void replay_record(const TraceRecord &r, ReplayCounts &counts);
+    void replay_summary(ReplayCounts &counts, std::chrono::steady_clock::time_point start);
+
+private:
+    PhysicalMemory phys_;
+    BuddyAllocator buddy_;
+    ActiveAllocator active_;
+    Cache l1_, l2_;
+    bool l1_ready_;
+    bool l2_ready_;
+    bool cache_specialize_;
+    VirtualMemory vm_;
+    bool vm_ready_;
+    NumaMemory numa_;
+    bool numa_ready_;
+    Dram dram_;
+    bool dram_ready_;
+    Telemetry telemetry_;
+    AllocatorFrames frames_;
+    Sampler sampler_;
+    //ordinals and counters of the daemon requests
+    ReplayCounts session_;
+};
+
+#endif
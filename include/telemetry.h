@@ -0,0 +1,98 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+/*
+Streaming telemetry
+- The simulator publishes a metrics snapshot every N events
+- A background thread emits the latest snapshot every T ms
+- Snapshots move through a lock-free triple buffer, so the hot path
+  only copies a small struct and swaps one atomic index
+
+Output formats:
+- JSONL: one JSON object per line, appended
+- PROMETHEUS: text exposition format, file rewritten atomically (textfile collector)
+*/
+
+enum class TelemetryFormat {
+    JSONL,
+    PROMETHEUS
+};
+
+//Metrics gathered from all components at one point in time
+struct TelemetrySnapshot {
+    std::uint64_t events;
+    std::size_t l1_hits;
+    std::size_t l1_misses;
+    std::size_t l2_hits;
+    std::size_t l2_misses;
+    std::size_t page_hits;
+    std::size_t page_faults;
+    double utilization;
+    double fragmentation;
+    std::size_t alloc_requests;
+    std::size_t failed_allocs;
+};
+
+class Telemetry {
+public:
+    Telemetry();
+    ~Telemetry();
+
+    Telemetry(const Telemetry &) = delete;
+    Telemetry &operator=(const Telemetry &) = delete;
+
+    //Start emitting to path, returns false if the file cannot be opened
+    bool start(const std::string &path, TelemetryFormat format,
+               std::uint64_t every_events, std::uint64_t every_ms);
+    //Flush the latest snapshot and join the background thread
+    void stop();
+    bool running() const { return running_; }
+
+    //Hot path: count one event, true when a snapshot should be published
+    bool tick() {
+        return running_ && ++events_ % every_events_ == 0;
+    }
+    std::uint64_t events() const { return events_; }
+
+    //Publish a snapshot (single producer)
+    void publish(const TelemetrySnapshot &snapshot);
+
+private:
+    void run();
+    bool take_latest(TelemetrySnapshot &out);
+    void emit(const TelemetrySnapshot &snapshot, double seconds);
+
+private:
+    //configuration
+    std::string path_;
+    TelemetryFormat format_;
+    std::uint64_t every_events_;
+    std::uint64_t every_ms_;
+
+    //producer side
+    bool running_;
+    std::uint64_t events_;
+
+    //triple buffer: producer owns back_, consumer owns front_,
+    //middle_ holds the index in between plus a "fresh" bit
+    TelemetrySnapshot buffers_[3];
+    int back_;
+    int front_;
+    std::atomic<int> middle_;
+
+    //consumer side
+    std::FILE *jsonl_;
+    std::atomic<bool> stop_requested_;
+    std::thread worker_;
+    std::uint64_t last_events_;
+    double last_seconds_;
+};
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "cache.h"
+
+/*
+Compact binary trace format (.mst)
+- Records are a one byte tag followed by a LEB128 varint argument
+- Addresses are delta encoded against the previous address of the same
+  stream and op, zigzag packed so small negative strides stay small
+- FREE refers to its MALLOC by ordinal (n-th MALLOC of the trace), encoded
+  as the distance back from the latest MALLOC
+- MALLOC_ALIGNED counts as a MALLOC; a second varint holds log2(alignment)
+- REALLOC refers to its MALLOC like FREE (the block keeps its ordinal),
+  a second varint holds the new size
+- BATCH n: the next n records, all MALLOC or all FREE, are one batch call
+- Records are grouped in blocks; delta state restarts at every block, so
+  blocks decode independently and in parallel
+
+Tag byte:
+| STREAM CHANGE (1) | unused (1) | ACCESS TYPE (2) | OP (4) |
+A set STREAM CHANGE bit is followed by a varint stream id
+ACCESS TYPE (read/write/ifetch) is only meaningful for ACCESS and VACCESS
+
+File layout:
+| MAGIC (8) | VERSION (4) | BLOCK RECORDS (4) | BLOCK | ... | BLOCK | INDEX | INDEX OFFSET (8) |
+BLOCK: | RECORDS (4) | PAYLOAD BYTES (4) | FIRST MALLOC ORDINAL (8) | PAYLOAD |
+INDEX: | BLOCK COUNT (8) | per block: OFFSET (8) RECORDS (4) FIRST MALLOC ORDINAL (8) |
+*/
+
+enum class TraceOp : std::uint8_t {
+    MALLOC = 0,  //value = size
+    FREE = 1,    //value = ordinal of the MALLOC being freed
+    ACCESS = 2,  //value = physical address
+    VACCESS = 3, //value = virtual address
+    MALLOC_ALIGNED = 4, //value = size, arg = alignment
+    REALLOC = 5, //value = ordinal of the MALLOC being resized, arg = new size
+    BATCH = 6    //value = number of MALLOC or FREE records that follow
+};
+
+struct TraceRecord {
+    TraceOp op;
+    std::uint32_t stream;
+    std::uint64_t value;
+    AccessType type = AccessType::READ;
+    std::uint64_t arg = 0;
+};
+
+//Streaming writer, one block is buffered in memory
+class TraceWriter {
+public:
+    TraceWriter();
+    ~TraceWriter();
+
+    TraceWriter(const TraceWriter &) = delete;
+    TraceWriter &operator=(const TraceWriter &) = delete;
+
+    bool open(const std::string &path, std::uint32_t block_records = 4096);
+    void append(const TraceRecord &record);
+    //Flush the last block and write the index, false on I/O failure
+    bool close();
+
+    std::uint64_t records() const { return records_; }
+    std::uint64_t bytes() const { return offset_; }
+
+private:
+    struct BlockInfo {
+        std::uint64_t offset;
+        std::uint32_t records;
+        std::uint64_t first_malloc;
+    };
+
+    void put_varint(std::uint64_t value);
+    void flush_block();
+    void write(const void *data, std::size_t size);
+
+private:
+    std::FILE *file_;
+    bool failed_;
+    std::uint32_t block_records_;
+    std::uint64_t offset_;
+    std::uint64_t records_;
+    std::uint64_t mallocs_;
+
+    //current block
+    std::vector<unsigned char> payload_;
+    std::uint32_t block_count_;
+    std::uint64_t block_first_malloc_;
+    std::uint32_t stream_;
+    //last physical / virtual address per stream
+    std::unordered_map<std::uint32_t, std::array<std::uint64_t, 2>> last_;
+    std::array<std::uint64_t, 2> *current_;
+
+    std::vector<BlockInfo> index_;
+};
+
+//Block indexed reader over a memory mapped trace
+class TraceReader {
+public:
+    TraceReader();
+    ~TraceReader();
+
+    TraceReader(const TraceReader &) = delete;
+    TraceReader &operator=(const TraceReader &) = delete;
+
+    bool open(const std::string &path);
+    void close();
+
+    std::size_t blocks() const { return index_.size(); }
+    std::uint64_t records() const { return records_; }
+    std::size_t size() const { return size_; }
+
+    //Decode one block (thread safe), false if the block is corrupt
+    bool decode_block(std::size_t block, std::vector<TraceRecord> &out) const;
+    //Decode count blocks starting at first on up to threads threads
+    bool decode_blocks(std::size_t first, std::size_t count,
+                       std::vector<std::vector<TraceRecord>> &out, unsigned threads) const;
+
+private:
+    struct BlockInfo {
+        std::uint64_t offset;
+        std::uint32_t records;
+        std::uint64_t first_malloc;
+    };
+
+private:
+    const unsigned char *data_;
+    std::size_t size_;
+    bool mapped_;
+    std::uint64_t records_;
+    std::vector<BlockInfo> index_;
+};
+
+//Convert a text command script (malloc/free/access/vaccess lines, and
+//malloc_aligned/realloc/malloc_batch/free_batch) to a trace.
+//A "stream <id>" line puts the following records on that stream.
+//Text ids are mapped to MALLOC ordinals by replaying the allocator's handle
+//assignment, which matches the original run as long as no malloc failed.
+//Returns false if a file cannot be opened; counts are reported on std::cout.
+bool trace_convert_text(const std::string &in_path, const std::string &out_path);
+
+#endif
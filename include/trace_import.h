@@ -0,0 +1,70 @@
+#ifndef TRACE_IMPORT_H
+#define TRACE_IMPORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "trace.h"
+
+/*
+Streaming importers for external memory traces
+- DINERO:   Dinero IV "din" text, "<label> <hex address> [size]" per line
+            label 0 = read, 1 = write, 2 = instruction fetch, others ignored
+- LACKEY:   valgrind --tool=lackey --trace-mem=yes output
+            "I  addr,size", " L addr,size", " S addr,size", " M addr,size"
+            M (modify) is a read followed by a write
+- CHAMPSIM: ChampSim style 64 byte binary instruction records
+            | IP (8) | BRANCH (2) | DST REGS (2) | SRC REGS (4) | DST MEM (2 x 8) | SRC MEM (4 x 8) |
+            one fetch of IP, a read per non-zero source and a write per non-zero destination
+
+Files are read in large chunks and parsed in place; every reference becomes
+an ACCESS (or VACCESS) TraceRecord with its access type.
+*/
+
+enum class ImportFormat {
+    DINERO,
+    LACKEY,
+    CHAMPSIM
+};
+
+class TraceImporter {
+public:
+    TraceImporter();
+    ~TraceImporter();
+
+    TraceImporter(const TraceImporter &) = delete;
+    TraceImporter &operator=(const TraceImporter &) = delete;
+
+    //Virtual addresses become VACCESS records, physical ones ACCESS
+    bool open(const std::string &path, ImportFormat format, bool is_virtual);
+    void close();
+
+    //Decode up to max references into out, false once the input is exhausted
+    bool next(std::vector<TraceRecord> &out, std::size_t max = 65536);
+
+    std::uint64_t references() const { return references_; }
+    std::uint64_t skipped() const { return skipped_; }
+
+private:
+    bool fill();
+    bool next_line(const char *&begin, const char *&end);
+    void parse_dinero(const char *p, const char *end, std::vector<TraceRecord> &out);
+    void parse_lackey(const char *p, const char *end, std::vector<TraceRecord> &out);
+    void parse_champsim(const unsigned char *record, std::vector<TraceRecord> &out);
+    void emit(std::uint64_t address, AccessType type, std::vector<TraceRecord> &out);
+
+private:
+    std::FILE *file_;
+    ImportFormat format_;
+    TraceOp op_;
+    std::vector<char> buffer_;
+    std::size_t begin_;
+    std::size_t end_;
+    bool eof_;
+    std::uint64_t references_;
+    std::uint64_t skipped_;
+};
+
+#endif
@@ -3,8 +3,12 @@
 
 #include <cstddef>
 #include <queue>
+#include <unordered_map>
 #include <unordered_set>
 #include <string>
+#include "checkpoint.h"
+#include "handle_table.h"
+#include "page_tracker.h"
 
 /*
 Virtual Memory Simulator (Paging + FIFO)
@@ -12,14 +16,30 @@ Virtual Memory Simulator (Paging + FIFO)
 - Paging-based virtual memory
 - FIFO page replacement
 - Disk is representational
+- Page frames come from a FrameProvider (one of the allocators),
+  page-ins allocate a frame and evictions free it
+- Optional working set tracking (page_tracker.h) sees every reference,
+  warming included, like a hardware accessed bit
 
 Virtual Address Format:
 | PAGE NUMBER | OFFSET |
 
 Physical Address:
-physical_address = page_number * page_size + offset
+physical_address = frame_address + offset
+(page_number * page_size + offset when no frame provider is attached)
 */
 
+//Source of physical page frames
+class FrameProvider {
+public:
+    virtual ~FrameProvider() {}
+    //Allocate a frame for a virtual page, INVALID_ID when memory is exhausted
+    virtual AllocId allocate_frame(std::size_t page_size, std::size_t vpage) = 0;
+    virtual void release_frame(AllocId frame) = 0;
+    //Current start address of a frame (frames may move, e.g. on compaction)
+    virtual bool frame_address(AllocId frame, std::size_t &address) const = 0;
+};
+
 class VirtualMemory {
 public:
     VirtualMemory();
@@ -27,19 +47,51 @@ public:
     //Initialize virtual memory system
     //page_size must be power of two
     bool init(std::size_t page_size, std::size_t num_pages);
+    //Attach a frame source (nullptr = identity mapping)
+    //Frames already held are released to the previous provider first
+    void set_frame_provider(FrameProvider *provider);
+    bool has_frame_provider() const { return frames_ != nullptr; }
+    //True if frame backs a resident page (it must not be freed by anyone else)
+    bool holds_frame(AllocId frame) const { return held_frames_.count(frame) > 0; }
     //Access a virtual address
     //Returns translated physical address
     std::size_t access(std::size_t virtual_address);
+    //Functional warming: translate and page in without touching statistics
+    std::size_t warm(std::size_t virtual_address);
     //Print virtual memory statistics
     void stats() const;
-    //Reset page table and stats
+    //Stats getters
+    std::size_t page_hits() const { return page_hits_; }
+    std::size_t page_faults() const { return page_faults_; }
+    std::size_t page_size() const { return page_size_; }
+    //True if the last access or warm paged data in
+    bool last_access_faulted() const { return last_fault_; }
+    //Reset page table and stats, frames are returned to the provider
     void reset();
+    //Working set tracking over all virtual pages
+    bool start_tracking(TrackMode mode, std::size_t window, std::size_t scan_interval);
+    void stop_tracking() { tracker_.stop(); }
+    const PageTracker &tracker() const { return tracker_; }
+    //Checkpoint
+    void save(CheckpointWriter &out) const;
+    //Restored frame ids are bound to provider without being released
+    bool load(CheckpointReader &in, FrameProvider *provider = nullptr);
 
 private:
     //Helpers
     bool is_power_of_two(std::size_t x) const;
     std::size_t extract_page_number(std::size_t vaddr) const;
     std::size_t extract_offset(std::size_t vaddr) const;
+    //Translation shared by access and warm
+    std::size_t translate(std::size_t vaddr, bool record);
+    //Physical start address of a resident page, false if its frame is gone
+    bool frame_base(std::size_t page_number, AllocId frame, std::size_t &address) const;
+    //Evict the oldest resident page
+    void evict_one(bool record);
+    //Unmap a page whose frame no longer exists, nothing is released
+    void forget(std::size_t page_number);
+    //Drop all resident pages, returning their frames
+    void release_all();
 
 private:
     //Configuration
@@ -47,16 +99,23 @@ private:
     std::size_t num_pages_;
     std::size_t offset_bits_;
 
-    //Page table(presence only)
-    std::unordered_set<std::size_t> resident_pages_;
+    //Page table: resident page -> frame id (INVALID_ID without provider)
+    std::unordered_map<std::size_t, AllocId> page_table_;
+    FrameProvider *frames_;
+    //Frame ids in the page table
+    std::unordered_set<AllocId> held_frames_;
 
     //FIFO replacement queue
     std::queue<std::size_t> fifo_queue_;
 
+    PageTracker tracker_;
+
     //Statistics
     std::size_t page_hits_;
     std::size_t page_faults_;
     std::size_t page_evictions_;
+    std::size_t frame_failures_;
+    bool last_fault_;
 };
 
 #endif
\ No newline at end of file
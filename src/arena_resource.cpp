@@ -0,0 +1,170 @@
+#include "arena_resource.h"
+#include <cstdlib>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace {
+constexpr std::size_t PAGE_SIZE = 4096;
+constexpr std::size_t HUGE_PAGE_SIZE = std::size_t(2) << 20;
+
+std::size_t round_up(std::size_t x, std::size_t align) {
+    return (x + align - 1) & ~(align - 1);
+}
+}
+
+
+//Arena
+
+Arena::Arena()
+    : base_(nullptr),
+      size_(0),
+      mapped_size_(0),
+      mmapped_(false),
+      huge_pages_(false) {}
+
+Arena::~Arena() {
+    release();
+}
+
+bool Arena::init(std::size_t size, bool huge_pages) {
+    release();
+    if (size == 0)
+        return false;
+
+#ifdef __linux__
+    if (huge_pages) {
+        std::size_t len = round_up(size, HUGE_PAGE_SIZE);
+
+        //explicit huge pages first, transparent huge pages as fallback
+        void *p = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p == MAP_FAILED) {
+            p = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED)
+                return false;
+            madvise(p, len, MADV_HUGEPAGE);
+        }
+
+        base_ = static_cast<unsigned char *>(p);
+        size_ = size;
+        mapped_size_ = len;
+        mmapped_ = true;
+        huge_pages_ = true;
+        return true;
+    }
+#else
+    (void)huge_pages;
+#endif
+
+    void *p = std::aligned_alloc(PAGE_SIZE, round_up(size, PAGE_SIZE));
+    if (!p)
+        return false;
+
+    base_ = static_cast<unsigned char *>(p);
+    size_ = size;
+    mapped_size_ = 0;
+    mmapped_ = false;
+    huge_pages_ = false;
+    return true;
+}
+
+void Arena::release() {
+    if (!base_)
+        return;
+#ifdef __linux__
+    if (mmapped_)
+        munmap(base_, mapped_size_);
+    else
+        std::free(base_);
+#else
+    std::free(base_);
+#endif
+    base_ = nullptr;
+    size_ = 0;
+    mapped_size_ = 0;
+    mmapped_ = false;
+    huge_pages_ = false;
+}
+
+
+//ArenaResource
+
+ArenaResource::ArenaResource(PhysicalMemory &phys, std::size_t arena_size, bool huge_pages)
+    : engine_(ArenaEngine::PHYSICAL),
+      phys_(&phys),
+      buddy_(nullptr),
+      ready_(false) {
+    if (!arena_.init(arena_size, huge_pages))
+        return;
+    phys_->init(arena_size);
+    phys_->set_compaction(CompactionPolicy::OFF);
+    ready_ = true;
+}
+
+ArenaResource::ArenaResource(BuddyAllocator &buddy, std::size_t arena_size, bool huge_pages)
+    : engine_(ArenaEngine::BUDDY),
+      phys_(nullptr),
+      buddy_(&buddy),
+      ready_(false) {
+    if (!arena_.init(arena_size, huge_pages))
+        return;
+    ready_ = buddy_->init(arena_size);
+}
+
+void *ArenaResource::do_allocate(std::size_t bytes, std::size_t alignment) {
+    if (!ready_)
+        throw std::bad_alloc();
+    if (bytes == 0)
+        bytes = 1;
+
+    AllocId id = INVALID_ID;
+    std::size_t address = 0;
+
+    switch (engine_) {
+        case ArenaEngine::PHYSICAL:
+            //block starts are byte granular, over-allocate to align inside the block
+            id = phys_->malloc(bytes + alignment - 1);
+            if (id != INVALID_ID)
+                phys_->address_of(id, address);
+            break;
+        case ArenaEngine::BUDDY:
+            //buddy blocks are aligned to their own size
+            id = buddy_->malloc(bytes < alignment ? alignment : bytes);
+            if (id != INVALID_ID)
+                buddy_->address_of(id, address);
+            break;
+    }
+
+    if (id == INVALID_ID)
+        throw std::bad_alloc();
+
+    std::size_t aligned = round_up(reinterpret_cast<std::size_t>(arena_.base() + address),
+                                   alignment);
+    void *p = reinterpret_cast<void *>(aligned);
+    live_[p] = id;
+    return p;
+}
+
+void ArenaResource::do_deallocate(void *p, std::size_t, std::size_t) {
+    auto it = live_.find(p);
+    if (it == live_.end())
+        return;
+
+    switch (engine_) {
+        case ArenaEngine::PHYSICAL:
+            phys_->free_block(it->second);
+            break;
+        case ArenaEngine::BUDDY:
+            buddy_->free_block(it->second);
+            break;
+    }
+    live_.erase(it);
+}
+
+bool ArenaResource::do_is_equal(const std::pmr::memory_resource &other) const noexcept {
+    return this == &other;
+}
@@ -0,0 +1,292 @@
+#include "benchmark.h"
+#include "arena_resource.h"
+#include "cache.h"
+#include "trace.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <list>
+#include <memory_resource>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsed_ns(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+struct ContainerTimings {
+    double build_ns;    //per list push_back
+    double traverse_ns; //per list element visited
+    double churn_ns;    //per list erase/insert
+    double vector_ns;   //per vector push_back (includes regrowth)
+    std::size_t checksum;
+};
+
+//Container workload shared by every resource
+ContainerTimings run_containers(std::pmr::memory_resource *resource, std::size_t count) {
+    ContainerTimings t{0, 0, 0, 0, 0};
+    const std::size_t passes = 10;
+
+    std::pmr::list<std::size_t> nodes(resource);
+
+    auto start = Clock::now();
+    for (std::size_t i = 0; i < count; i++)
+        nodes.push_back(i);
+    t.build_ns = elapsed_ns(start) / count;
+
+    start = Clock::now();
+    for (std::size_t p = 0; p < passes; p++) {
+        for (std::size_t v : nodes)
+            t.checksum += v;
+    }
+    t.traverse_ns = elapsed_ns(start) / (count * passes);
+
+    //free every other node, then refill the holes
+    start = Clock::now();
+    std::size_t ops = 0;
+    for (auto it = nodes.begin(); it != nodes.end();) {
+        it = nodes.erase(it);
+        if (it != nodes.end())
+            ++it;
+        ops++;
+    }
+    for (std::size_t i = 0; i < count / 2; i++) {
+        nodes.push_back(i);
+        ops++;
+    }
+    t.churn_ns = elapsed_ns(start) / ops;
+
+    start = Clock::now();
+    {
+        std::pmr::vector<std::size_t> values(resource);
+        for (std::size_t i = 0; i < count; i++)
+            values.push_back(i);
+        t.checksum += values.back();
+    }
+    t.vector_ns = elapsed_ns(start) / count;
+
+    return t;
+}
+
+//Replay-like stream: strided sweeps with occasional jumps,
+//a few allocator events mixed in
+std::vector<TraceRecord> synthetic_trace(std::size_t count) {
+    std::mt19937_64 rng(42);
+    std::vector<TraceRecord> records;
+    records.reserve(count);
+    std::uint64_t address = 0, mallocs = 0;
+    for (std::size_t i = 0; i < count; i++) {
+        std::uint64_t r = rng();
+        if (r % 64 == 0) {
+            records.push_back({TraceOp::MALLOC, 0, 16 + r % 512});
+            mallocs++;
+        } else if (r % 64 == 1 && mallocs > 0) {
+            records.push_back({TraceOp::FREE, 0, (r >> 8) % mallocs});
+        } else {
+            address = (r % 97 == 0) ? (r >> 16) % (std::uint64_t(1) << 32) : address + 64;
+            records.push_back({(r % 5 == 0) ? TraceOp::VACCESS : TraceOp::ACCESS, 0, address});
+        }
+    }
+    return records;
+}
+
+void print_row(const std::string &name, const ContainerTimings &t) {
+    std::cout << name
+              << " build=" << t.build_ns << "ns"
+              << " traverse=" << t.traverse_ns << "ns"
+              << " churn=" << t.churn_ns << "ns"
+              << " vector=" << t.vector_ns << "ns\n";
+}
+
+}
+
+
+void bench_arena(std::size_t count, bool huge_pages) {
+    if (count == 0) {
+        std::cout << "Invalid benchmark size\n";
+        return;
+    }
+
+    //list nodes, vector regrowth and alignment slack all fit comfortably
+    std::size_t arena_size = std::size_t(1) << 20;
+    while (arena_size < count * 128)
+        arena_size <<= 1;
+
+    std::cout << "Arena benchmark: " << count << " elements, arena "
+              << arena_size << " bytes" << (huge_pages ? ", huge pages" : "") << "\n";
+
+    print_row("default_heap", run_containers(std::pmr::new_delete_resource(), count));
+
+    const std::pair<const char *, AllocatorType> strategies[] = {
+        {"first_fit", AllocatorType::FIRST_FIT},
+        {"best_fit", AllocatorType::BEST_FIT},
+        {"worst_fit", AllocatorType::WORST_FIT},
+    };
+
+    for (const auto &s : strategies) {
+        PhysicalMemory phys;
+        ArenaResource resource(phys, arena_size, huge_pages);
+        if (!resource.ready()) {
+            std::cout << s.first << " arena unavailable\n";
+            continue;
+        }
+        phys.set_allocator(s.second);
+        try {
+            print_row(s.first, run_containers(&resource, count));
+        } catch (const std::bad_alloc &) {
+            std::cout << s.first << " ran out of arena memory\n";
+        }
+    }
+
+    BuddyAllocator buddy;
+    ArenaResource resource(buddy, arena_size, huge_pages);
+    if (!resource.ready()) {
+        std::cout << "buddy arena unavailable\n";
+        return;
+    }
+    try {
+        print_row("buddy", run_containers(&resource, count));
+    } catch (const std::bad_alloc &) {
+        std::cout << "buddy ran out of arena memory\n";
+    }
+}
+
+
+void bench_trace(std::size_t count) {
+    if (count == 0) {
+        std::cout << "Invalid benchmark size\n";
+        return;
+    }
+
+    std::vector<TraceRecord> records = synthetic_trace(count);
+
+    std::string path = (std::filesystem::temp_directory_path() / "memsim_bench.mst").string();
+
+    auto start = Clock::now();
+    TraceWriter writer;
+    if (!writer.open(path)) {
+        std::cout << "Cannot write " << path << "\n";
+        return;
+    }
+    for (const auto &record : records)
+        writer.append(record);
+    bool written = writer.close();
+    double encode_ns = elapsed_ns(start) / count;
+    if (!written) {
+        std::cout << "Cannot write " << path << "\n";
+        return;
+    }
+
+    TraceReader reader;
+    if (!reader.open(path)) {
+        std::cout << "Cannot read " << path << "\n";
+        std::remove(path.c_str());
+        return;
+    }
+
+    std::vector<std::vector<TraceRecord>> blocks;
+    start = Clock::now();
+    bool decoded = reader.decode_blocks(0, reader.blocks(), blocks, 1);
+    double decode_ns = elapsed_ns(start) / count;
+
+    unsigned threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+    start = Clock::now();
+    decoded = reader.decode_blocks(0, reader.blocks(), blocks, threads) && decoded;
+    double parallel_ns = elapsed_ns(start) / count;
+
+    //round trip check
+    std::size_t i = 0;
+    for (const auto &block : blocks) {
+        for (const auto &record : block) {
+            if (record.op != records[i].op || record.value != records[i].value)
+                decoded = false;
+            i++;
+        }
+    }
+    std::remove(path.c_str());
+    if (!decoded || i != count) {
+        std::cout << "Trace round trip mismatch\n";
+        return;
+    }
+
+    Cache cache;
+    cache.init("L1", 32768, 64, 8);
+    start = Clock::now();
+    for (const auto &record : records) {
+        if (record.op == TraceOp::ACCESS || record.op == TraceOp::VACCESS)
+            cache.access(record.value);
+    }
+    double cache_ns = elapsed_ns(start) / count;
+
+    std::cout << "Trace benchmark: " << count << " records, "
+              << reader.size() << " bytes (" << (double)reader.size() / count
+              << " bytes/record, raw 9)\n";
+    std::cout << "encode=" << encode_ns << "ns"
+              << " decode=" << decode_ns << "ns"
+              << " decode_" << threads << "t=" << parallel_ns << "ns"
+              << " cache_access=" << cache_ns << "ns\n";
+    std::cout << "Decode is " << cache_ns / decode_ns << "x (single thread) and "
+              << cache_ns / parallel_ns << "x (parallel) Cache::access throughput\n";
+}
+
+
+void bench_cache(std::size_t cache_size, std::size_t block_size, std::size_t ways, std::size_t count) {
+    if (count == 0) {
+        std::cout << "Invalid benchmark size\n";
+        return;
+    }
+
+    //replay-like stream: a hot working set of half the cache plus a streaming sweep
+    std::mt19937_64 rng(7);
+    std::vector<std::size_t> addresses;
+    addresses.reserve(count);
+    std::size_t hot = (cache_size / 2 > 0) ? cache_size / 2 : 1;
+    std::size_t sweep = std::size_t(1) << 32;
+    for (std::size_t i = 0; i < count; i++) {
+        std::uint64_t r = rng();
+        addresses.push_back((r % 5 != 0) ? (r >> 8) % hot : (sweep += block_size));
+    }
+    const std::size_t passes = 5;
+
+    Cache runtime, specialized;
+    if (!runtime.init("runtime", cache_size, block_size, ways, false) ||
+        !specialized.init("specialized", cache_size, block_size, ways, true))
+        return;
+
+    auto run = [&](Cache &cache) {
+        auto start = Clock::now();
+        for (std::size_t p = 0; p < passes; p++) {
+            for (std::size_t address : addresses)
+                cache.access(address);
+        }
+        return elapsed_ns(start) / (addresses.size() * passes);
+    };
+
+    double runtime_ns = run(runtime);
+    std::cout << "Cache benchmark: " << cache_size << " bytes, " << block_size << " byte blocks, "
+              << ways << " ways, " << addresses.size() * passes << " accesses\n";
+    std::cout << "runtime=" << runtime_ns << "ns";
+
+    if (!specialized.specialized()) {
+        std::cout << "\nGeometry not registered, Cache uses the runtime version\n";
+        return;
+    }
+
+    double specialized_ns = run(specialized);
+    std::cout << " specialized=" << specialized_ns << "ns"
+              << " speedup=" << runtime_ns / specialized_ns << "x\n";
+    if (runtime.hits() != specialized.hits() || runtime.misses() != specialized.misses())
+        std::cout << "Hit counts differ between runtime and specialized cache\n";
+    else
+        std::cout << "Identical hits (" << runtime.hits() << ") and misses (" << runtime.misses() << ")\n";
+}
@@ -1,26 +1,36 @@
 #include "buddy_allocator.h"
+#include "perf_counters.h"
 #include <iostream>
 #include<algorithm>
 #include <cmath>
+#include <functional>
+#include <map>
+#include <unordered_set>
 
 BuddyAllocator::BuddyAllocator()
     : total_size_(0),
       max_order_(0),
-      next_id_(1),
-      used_memory_(0), 
+      used_memory_(0),
       total_alloc_requests_(0),
       successful_allocs_(0),
-      failed_allocs_(0) {}
+      failed_allocs_(0),
+      invalid_frees_(0),
+      aligned_allocs_(0),
+      reallocs_(0),
+      reallocs_in_place_(0),
+      realloc_bytes_copied_(0),
+      batches_(0),
+      batched_requests_(0) {}
 
 
 //Utility Functions
 
-//check for x 
+//check for x
 bool BuddyAllocator::is_power_of_two(std::size_t x) const {
     return x > 0 && (x & (x - 1)) == 0;
 }
 
-//round up 
+//round up
 std::size_t BuddyAllocator::next_power_of_two(std::size_t x) const {
     if (x == 0) return 1;
     if (is_power_of_two(x)) return x;
@@ -44,113 +54,266 @@ std::size_t BuddyAllocator::order_to_size(int order) const {
     return std::size_t(1) << order;
 }
 
+const char *BuddyAllocator::zone_name(ZoneType type) {
+    switch (type) {
+        case ZoneType::DMA:     return "DMA";
+        case ZoneType::NORMAL:  return "Normal";
+        case ZoneType::MOVABLE: return "Movable";
+    }
+    return "?";
+}
+
 //Initialization
 bool BuddyAllocator::init(std::size_t total_size) {
-    if (!is_power_of_two(total_size)) {
-        std::cout << "Buddy allocator requires total memory to be power of two\n";
+    if (total_size == 0) {
+        std::cout << "Buddy allocator requires a non-zero memory size\n";
         return false;
     }
 
     total_size_ = total_size;
+    //largest block that fits: floor(log2(total_size))
     max_order_ = size_to_order(total_size_);
-
-    free_lists_.clear();
-    free_lists_.resize(max_order_ + 1);
+    if (order_to_size(max_order_) > total_size_)
+        max_order_--;
 
     allocated_.clear();
-    next_id_ = 1;
 
     used_memory_ = 0;
     total_alloc_requests_ = 0;
     successful_allocs_ = 0;
     failed_allocs_ = 0;
+    invalid_frees_ = 0;
+    aligned_allocs_ = 0;
+    reallocs_ = 0;
+    reallocs_in_place_ = 0;
+    realloc_bytes_copied_ = 0;
+    batches_ = 0;
+    batched_requests_ = 0;
+
+    zones_.clear();
+    add_zone(ZoneType::NORMAL, 0, total_size_);
+    return true;
+}
+
+bool BuddyAllocator::zones_valid(std::size_t dma_size, std::size_t movable_size) const {
+    //NORMAL keeps at least one byte
+    return total_size_ != 0 && dma_size < total_size_ && movable_size < total_size_ - dma_size;
+}
 
-    //one free block initially
-    free_lists_[max_order_].push_back(0);
+bool BuddyAllocator::set_zones(std::size_t dma_size, std::size_t movable_size) {
+    if (!zones_valid(dma_size, movable_size))
+        return false;
 
+    init(total_size_);
+    zones_.clear();
+    std::size_t normal_size = total_size_ - dma_size - movable_size;
+    if (dma_size > 0)
+        add_zone(ZoneType::DMA, 0, dma_size);
+    add_zone(ZoneType::NORMAL, dma_size, normal_size);
+    if (movable_size > 0)
+        add_zone(ZoneType::MOVABLE, dma_size + normal_size, movable_size);
     return true;
 }
 
+bool BuddyAllocator::set_watermark(ZoneType type, std::size_t min) {
+    for (auto &zone : zones_) {
+        if (zone.type != type)
+            continue;
+        zone.wmark_min = min;
+        zone.wmark_low = min + min / 4;
+        zone.wmark_high = min + min / 2;
+        return true;
+    }
+    return false;
+}
+
+//The zone's range as free blocks: at every address the largest naturally
+//aligned block that still fits
+void BuddyAllocator::add_zone(ZoneType type, std::size_t start, std::size_t size) {
+    Zone zone{type, start, size, 0, {}, 0, 0, 0, 0, 0, 0, 0};
+    zone.free_lists.resize(max_order_ + 1);
+
+    std::size_t addr = start;
+    std::size_t end = start + size;
+    while (addr < end) {
+        int order = max_order_;
+        while (order > 0 && (addr % order_to_size(order) != 0 || order_to_size(order) > end - addr))
+            order--;
+        zone.free_lists[order].push_back(addr);
+        addr += order_to_size(order);
+    }
+    zones_.push_back(std::move(zone));
+}
+
+std::size_t BuddyAllocator::zone_index(std::size_t addr) const {
+    std::size_t i = 0;
+    while (i + 1 < zones_.size() && addr >= zones_[i + 1].start)
+        i++;
+    return i;
+}
+
+
+//Zone selection
+BuddyAllocator::Zone *BuddyAllocator::home_zone(ZoneType preferred) {
+    for (auto it = zones_.rbegin(); it != zones_.rend(); ++it) {
+        if (it->type <= preferred)
+            return &*it;
+    }
+    return nullptr;
+}
+
+BuddyAllocator::Zone *BuddyAllocator::pick_zone(int order, ZoneType preferred, std::size_t &mark, bool &fallback) {
+    std::size_t bytes = order_to_size(order);
+    Zone *home = home_zone(preferred);
+    auto has_block = [&](const Zone &zone) {
+        for (int k = order; k <= max_order_; k++) {
+            if (!zone.free_lists[k].empty())
+                return true;
+        }
+        return false;
+    };
+
+    //pass 0 keeps every zone above its low watermark, pass 1 above min
+    for (int pass = 0; pass < 2; pass++) {
+        for (auto it = zones_.rbegin(); it != zones_.rend(); ++it) {
+            if (it->type > preferred)
+                continue;
+            std::size_t wmark = (pass == 0) ? it->wmark_low : it->wmark_min;
+            if (it->size - it->used >= bytes + wmark && has_block(*it)) {
+                mark = wmark;
+                fallback = &*it != home;
+                return &*it;
+            }
+        }
+        if (pass == 0) {
+            for (auto &zone : zones_) {
+                if (zone.type <= preferred && zone.size - zone.used < bytes + zone.wmark_low)
+                    zone.kswapd_wakeups++;
+            }
+        }
+    }
+    return nullptr;
+}
+
 
-int BuddyAllocator::allocate_block(int order) {
+bool BuddyAllocator::take_block(Zone &zone, int order, std::size_t &addr) {
     //find smallest available block>=order
     int current = order;
-    while (current <= max_order_ && free_lists_[current].empty()) {
+    while (current <= max_order_ && zone.free_lists[current].empty()) {
         current++;
     }
 
     if (current > max_order_) {
-        return -1; //no memory
+        return false; //no memory
     }
 
     //split blocks until we reach required order
     while (current > order) {
-        split_block(current, current - 1);
+        split_block(zone, current, current - 1);
         current--;
     }
 
     //allocate block from free list
-    std::size_t addr = free_lists_[order].front();
-    free_lists_[order].pop_front();
+    addr = zone.free_lists[order].front();
+    zone.free_lists[order].pop_front();
+    return true;
+}
 
-    int id = next_id_++;
-    allocated_[id] = {addr, order};
+bool BuddyAllocator::take_free(Zone &zone, std::size_t addr, int order) {
+    auto &list = zone.free_lists[order];
+    auto it = std::find(list.begin(), list.end(), addr);
+    if (it == list.end())
+        return false;
+    list.erase(it);
+    return true;
+}
 
-    used_memory_ += order_to_size(order);
-    successful_allocs_++;
+AllocId BuddyAllocator::malloc(std::size_t size) {
+    PERF_SCOPE(BUDDY_MALLOC);
+    return allocate_request(size, 0, ZoneType::NORMAL);
+}
+
+AllocId BuddyAllocator::malloc_zone(std::size_t size, ZoneType zone) {
+    PERF_SCOPE(BUDDY_MALLOC);
+    return allocate_request(size, 0, zone);
+}
 
+AllocId BuddyAllocator::malloc_aligned(std::size_t size, std::size_t alignment) {
+    PERF_SCOPE(BUDDY_MALLOC);
+    if (!is_power_of_two(alignment)) {
+        total_alloc_requests_++;
+        failed_allocs_++;
+        return INVALID_ID;
+    }
+    AllocId id = allocate_request(size, size_to_order(alignment), ZoneType::NORMAL);
+    if (id != INVALID_ID)
+        aligned_allocs_++;
     return id;
 }
 
-int BuddyAllocator::malloc(std::size_t size) {
+AllocId BuddyAllocator::allocate_request(std::size_t size, int min_order, ZoneType preferred) {
     total_alloc_requests_++;
 
     if (size == 0) {
         failed_allocs_++;
-        return -1;
+        return INVALID_ID;
     }
 
     std::size_t rounded = next_power_of_two(size);
-    int order = size_to_order(rounded);
+    int order = std::max(size_to_order(rounded), min_order);
 
-    if (order > max_order_) {
+    std::size_t mark = 0;
+    bool fallback = false;
+    Zone *zone = (order <= max_order_) ? pick_zone(order, preferred, mark, fallback) : nullptr;
+    std::size_t addr = 0;
+    if (!zone || !take_block(*zone, order, addr)) {
         failed_allocs_++;
-        return -1;
+        if (Zone *home = home_zone(preferred))
+            home->failed++;
+        return INVALID_ID;
     }
 
-    int id = allocate_block(order);
-    if (id == -1) {
-        failed_allocs_++;
-    }
+    AllocId id = allocated_.insert({addr, order});
+
+    used_memory_ += order_to_size(order);
+    zone->used += order_to_size(order);
+    zone->allocs++;
+    if (fallback)
+        zone->fallback_allocs++;
+    successful_allocs_++;
 
     return id;
 }
 
 
-void BuddyAllocator::split_block(int from_order, int to_order) {
+void BuddyAllocator::split_block(Zone &zone, int from_order, int to_order) {
     //take one block from higher order
-    std::size_t addr = free_lists_[from_order].front();
-    free_lists_[from_order].pop_front();
+    std::size_t addr = zone.free_lists[from_order].front();
+    zone.free_lists[from_order].pop_front();
 
     std::size_t size = order_to_size(to_order);
 
     std::size_t left = addr;
     std::size_t right = addr + size;
 
-    free_lists_[to_order].push_back(left);
-    free_lists_[to_order].push_back(right);
+    zone.free_lists[to_order].push_back(left);
+    zone.free_lists[to_order].push_back(right);
 }
 
 
 
-void BuddyAllocator::try_coalesce(std::size_t addr, int order) {
-    if (order >= max_order_)
+//A buddy outside the zone never shows up in its free lists, so blocks at
+//the edge of a zone (or of memory) stay unmerged
+void BuddyAllocator::try_coalesce(Zone &zone, std::size_t addr, int order) {
+    if (order >= max_order_) {
+        zone.free_lists[order].push_back(addr);
         return;
+    }
 
     std::size_t block_size = order_to_size(order);
     std::size_t buddy = addr ^ block_size;
 
-    auto &free_list = free_lists_[order];
+    auto &free_list = zone.free_lists[order];
 
     for (auto it = free_list.begin(); it != free_list.end(); ++it) {
         if (*it == buddy) {
@@ -159,7 +322,7 @@ void BuddyAllocator::try_coalesce(std::size_t addr, int order) {
             //merged block starts at min(addr, buddy)
             std::size_t merged_addr = std::min(addr, buddy);
             // try to coalesce at next higher order
-            try_coalesce(merged_addr, order + 1);
+            try_coalesce(zone, merged_addr, order + 1);
             return;
         }
     }
@@ -171,54 +334,301 @@ void BuddyAllocator::try_coalesce(std::size_t addr, int order) {
 
 void BuddyAllocator::dump() const {
     std::cout << "Buddy Free Lists:\n";
-    for (int i = 0; i <= max_order_; i++) {
-        std::cout << "Order " << i << " (size " << order_to_size(i) << "): ";
-        for (auto addr : free_lists_[i]) {
-            std::cout << addr << " ";
+    for (const auto &zone : zones_) {
+        if (zones_.size() > 1) {
+            std::cout << "Zone " << zone_name(zone.type) << " [" << zone.start << " - "
+                      << zone.start + zone.size - 1 << "]\n";
+        }
+        for (int i = 0; i <= max_order_; i++) {
+            std::cout << "Order " << i << " (size " << order_to_size(i) << "): ";
+            for (auto addr : zone.free_lists[i]) {
+                std::cout << addr << " ";
+            }
+            std::cout << "\n";
         }
-        std::cout << "\n";
     }
 }
 
 
-bool BuddyAllocator::free_block(int id) {
-    auto it = allocated_.find(id);
-    if (it == allocated_.end())
+bool BuddyAllocator::free_block(AllocId id) {
+    PERF_SCOPE(BUDDY_FREE);
+    auto *block = allocated_.find(id);
+    if (!block) {
+        //unknown, stale or double free
+        invalid_frees_++;
         return false;
+    }
 
-    std::size_t addr = it->second.first;
-    int order = it->second.second;
+    std::size_t addr = block->first;
+    int order = block->second;
 
-    allocated_.erase(it);
+    allocated_.erase(id);
 
+    Zone &zone = zones_[zone_index(addr)];
     used_memory_ -= order_to_size(order);
+    zone.used -= order_to_size(order);
 
     // attempt buddy coalescing
-    try_coalesce(addr, order);
+    try_coalesce(zone, addr, order);
 
     return true;
 }
 
 
-void BuddyAllocator::stats() const {
-    std::size_t free_memory = total_size_ - used_memory_;
-    std::size_t largest_free = 0;
+//Realloc
+bool BuddyAllocator::realloc(AllocId id, std::size_t size) {
+    PERF_SCOPE(BUDDY_MALLOC);
+    auto *block = allocated_.find(id);
+    if (!block || size == 0)
+        return false;
+
+    std::size_t addr = block->first;
+    int order = block->second;
+    int target = size_to_order(next_power_of_two(size));
+    if (target > max_order_)
+        return false;
+    reallocs_++;
+    Zone &zone = zones_[zone_index(addr)];
+
+    //shrink: the upper halves go back to the free lists (their buddies,
+    //the lower halves, are still in use so nothing coalesces)
+    if (target <= order) {
+        for (int k = order - 1; k >= target; k--)
+            zone.free_lists[k].push_back(addr + order_to_size(k));
+        used_memory_ -= order_to_size(order) - order_to_size(target);
+        zone.used -= order_to_size(order) - order_to_size(target);
+        block->second = target;
+        reallocs_in_place_++;
+        return true;
+    }
 
-    for (int i = 0; i <= max_order_; i++) {
-        if (!free_lists_[i].empty()) {
-            largest_free = std::max(largest_free, order_to_size(i));
+    //grow in place: the block must be the left half at every level up to
+    //target and every right buddy on the way must be free
+    bool in_place = addr % order_to_size(target) == 0;
+    for (int k = order; in_place && k < target; k++) {
+        const auto &list = zone.free_lists[k];
+        in_place = std::find(list.begin(), list.end(), addr + order_to_size(k)) != list.end();
+    }
+    if (in_place) {
+        for (int k = order; k < target; k++)
+            take_free(zone, addr + order_to_size(k), k);
+        used_memory_ += order_to_size(target) - order_to_size(order);
+        zone.used += order_to_size(target) - order_to_size(order);
+        block->second = target;
+        reallocs_in_place_++;
+        return true;
+    }
+
+    //move within the block's zonelist: take the new block before
+    //releasing the old one
+    std::size_t mark = 0, moved = 0;
+    bool fallback = false;
+    Zone *target_zone = pick_zone(target, zone.type, mark, fallback);
+    if (!target_zone || !take_block(*target_zone, target, moved))
+        return false;
+    *block = {moved, target};
+    used_memory_ += order_to_size(target) - order_to_size(order);
+    target_zone->used += order_to_size(target);
+    target_zone->allocs++;
+    if (fallback)
+        target_zone->fallback_allocs++;
+    zone.used -= order_to_size(order);
+    realloc_bytes_copied_ += order_to_size(order);
+    try_coalesce(zone, addr, order);
+    return true;
+}
+
+
+//Batches
+//Requests are served largest order first. A request that finds its free
+//list empty splits one larger block in a single step: the front pieces
+//serve as many requests of the batch as they can (down to the zone's
+//watermark), the tail goes back to the free lists as naturally aligned
+//blocks. Ids are handed out in request order.
+std::size_t BuddyAllocator::malloc_batch(const std::vector<std::size_t> &sizes, std::vector<AllocId> &ids) {
+    PERF_SCOPE(BUDDY_MALLOC);
+    batches_++;
+    batched_requests_ += sizes.size();
+    total_alloc_requests_ += sizes.size();
+    ids.assign(sizes.size(), INVALID_ID);
+
+    std::map<int, std::vector<std::size_t>, std::greater<int>> groups;
+    for (std::size_t i = 0; i < sizes.size(); i++) {
+        if (sizes[i] == 0)
+            continue;
+        int order = size_to_order(next_power_of_two(sizes[i]));
+        if (order <= max_order_ && !zones_.empty())
+            groups[order].push_back(i);
+    }
+
+    std::vector<std::pair<std::size_t, int>> blocks(sizes.size(), {0, -1});
+    for (const auto &group : groups) {
+        int order = group.first;
+        const auto &requests = group.second;
+        std::size_t bytes = order_to_size(order);
+        std::size_t next = 0;
+
+        while (next < requests.size()) {
+            std::size_t mark = 0;
+            bool fallback = false;
+            Zone *zone = pick_zone(order, ZoneType::NORMAL, mark, fallback);
+            if (!zone)
+                break;
+            auto &lists = zone->free_lists;
+            std::size_t served = 1;
+
+            if (!lists[order].empty()) {
+                blocks[requests[next++]] = {lists[order].front(), order};
+                lists[order].pop_front();
+            } else {
+                int larger = order + 1;
+                while (lists[larger].empty())
+                    larger++;
+
+                std::size_t addr = lists[larger].front();
+                lists[larger].pop_front();
+                std::size_t pieces = std::size_t(1) << (larger - order);
+                std::size_t allowed = (zone->size - zone->used - mark) / bytes;
+                served = std::min({pieces, requests.size() - next, allowed});
+                for (std::size_t p = 0; p < served; p++)
+                    blocks[requests[next++]] = {addr + p * bytes, order};
+                //tail [served, pieces) as the largest aligned runs
+                for (std::size_t p = served; p < pieces; p += p & (~p + 1)) {
+                    std::size_t run = p & (~p + 1);
+                    lists[order + size_to_order(run)].push_back(addr + p * bytes);
+                }
+            }
+
+            zone->used += served * bytes;
+            zone->allocs += served;
+            if (fallback)
+                zone->fallback_allocs += served;
         }
     }
 
-    double utilization = (total_size_ == 0)
+    std::size_t done = 0;
+    for (std::size_t i = 0; i < sizes.size(); i++) {
+        if (blocks[i].second < 0) {
+            failed_allocs_++;
+            if (Zone *home = home_zone(ZoneType::NORMAL))
+                home->failed++;
+            continue;
+        }
+        ids[i] = allocated_.insert(blocks[i]);
+        used_memory_ += order_to_size(blocks[i].second);
+        successful_allocs_++;
+        done++;
+    }
+    return done;
+}
+
+//Freed blocks are coalesced zone by zone, order by order: every order's
+//free list is put in a hash set once per batch instead of being searched
+//once per freed block. The result is the same maximal merging as single
+//frees.
+std::size_t BuddyAllocator::free_batch(const std::vector<AllocId> &ids) {
+    PERF_SCOPE(BUDDY_FREE);
+    batches_++;
+    batched_requests_ += ids.size();
+
+    //pending[zone][order]
+    std::vector<std::vector<std::vector<std::size_t>>> pending(
+        zones_.size(), std::vector<std::vector<std::size_t>>(max_order_ + 1));
+    std::size_t done = 0;
+    for (AllocId id : ids) {
+        auto *block = allocated_.find(id);
+        if (!block) {
+            invalid_frees_++;
+            continue;
+        }
+        std::size_t z = zone_index(block->first);
+        pending[z][block->second].push_back(block->first);
+        used_memory_ -= order_to_size(block->second);
+        zones_[z].used -= order_to_size(block->second);
+        allocated_.erase(id);
+        done++;
+    }
+
+    for (std::size_t z = 0; z < zones_.size(); z++) {
+        for (int order = 0; order <= max_order_; order++) {
+            auto &freed = pending[z][order];
+            if (freed.empty())
+                continue;
+            auto &list = zones_[z].free_lists[order];
+            if (order == max_order_) {
+                list.insert(list.end(), freed.begin(), freed.end());
+                continue;
+            }
+
+            std::unordered_set<std::size_t> listed(list.begin(), list.end());
+            std::unordered_set<std::size_t> waiting(freed.begin(), freed.end());
+            std::unordered_set<std::size_t> merged_from_list;
+            for (std::size_t addr : freed) {
+                if (!waiting.count(addr))
+                    continue;  //already merged as another block's buddy
+                std::size_t buddy = addr ^ order_to_size(order);
+                if (waiting.count(buddy)) {
+                    waiting.erase(buddy);
+                } else if (listed.count(buddy)) {
+                    listed.erase(buddy);
+                    merged_from_list.insert(buddy);
+                } else {
+                    continue;
+                }
+                waiting.erase(addr);
+                pending[z][order + 1].push_back(std::min(addr, buddy));
+            }
+
+            if (!merged_from_list.empty())
+                list.remove_if([&](std::size_t addr) { return merged_from_list.count(addr) > 0; });
+            for (std::size_t addr : freed) {
+                if (waiting.count(addr))
+                    list.push_back(addr);
+            }
+        }
+    }
+    return done;
+}
+
+
+bool BuddyAllocator::address_of(AllocId id, std::size_t &address) const {
+    auto *block = allocated_.find(id);
+    if (!block)
+        return false;
+    address = block->first;
+    return true;
+}
+
+
+double BuddyAllocator::utilization() const {
+    return (total_size_ == 0)
         ? 0.0
         : (double)used_memory_ / total_size_;
+}
+
+double BuddyAllocator::external_fragmentation() const {
+    std::size_t free_memory = total_size_ - used_memory_;
+    std::size_t largest_free = 0;
 
-    double external_frag = 0.0;
-    if (free_memory > 0 && largest_free < free_memory) {
-        external_frag = 1.0 - (double)largest_free / free_memory;
+    for (const auto &zone : zones_) {
+        for (std::size_t i = 0; i < zone.free_lists.size(); i++) {
+            if (!zone.free_lists[i].empty()) {
+                largest_free = std::max(largest_free, order_to_size(static_cast<int>(i)));
+            }
+        }
     }
 
+    if (free_memory > 0 && largest_free < free_memory)
+        return 1.0 - (double)largest_free / free_memory;
+    return 0.0;
+}
+
+
+void BuddyAllocator::stats() const {
+    std::size_t free_memory = total_size_ - used_memory_;
+    double utilization = this->utilization();
+    double external_frag = external_fragmentation();
+
     std::cout << "Buddy Allocator Stats\n";
     std::cout << "Total memory: " << total_size_ << "\n";
     std::cout << "Used memory: " << used_memory_ << "\n";
@@ -228,4 +638,124 @@ void BuddyAllocator::stats() const {
     std::cout << "Alloc requests: " << total_alloc_requests_ << "\n";
     std::cout << "Successful allocs: " << successful_allocs_ << "\n";
     std::cout << "Failed allocs: " << failed_allocs_ << "\n";
-}
\ No newline at end of file
+    if (invalid_frees_ > 0)
+        std::cout << "Invalid frees: " << invalid_frees_ << "\n";
+    if (aligned_allocs_ > 0)
+        std::cout << "Aligned allocs: " << aligned_allocs_ << "\n";
+    if (reallocs_ > 0) {
+        std::cout << "Reallocs: " << reallocs_ << " (in place " << reallocs_in_place_
+                  << ", bytes copied " << realloc_bytes_copied_ << ")\n";
+    }
+    if (batches_ > 0)
+        std::cout << "Batches: " << batches_ << " (" << batched_requests_ << " requests)\n";
+
+    for (const auto &zone : zones_) {
+        std::size_t free_bytes = zone.size - zone.used;
+        const char *level = (free_bytes < zone.wmark_min)  ? "below min"
+                          : (free_bytes < zone.wmark_low)  ? "below low"
+                          : (free_bytes < zone.wmark_high) ? "below high"
+                                                           : "ok";
+        std::cout << "Zone " << zone_name(zone.type) << " [" << zone.start << " - "
+                  << zone.start + zone.size - 1 << "]: free " << free_bytes << " of " << zone.size << "\n";
+        std::cout << "  Watermarks min/low/high: " << zone.wmark_min << "/" << zone.wmark_low << "/"
+                  << zone.wmark_high << " (" << level << ")\n";
+        std::cout << "  Allocs: " << zone.allocs << " (fallback " << zone.fallback_allocs
+                  << "), kswapd wakeups: " << zone.kswapd_wakeups << ", failed: " << zone.failed << "\n";
+    }
+}
+
+
+//Checkpoint
+void BuddyAllocator::save(CheckpointWriter &out) const {
+    out.begin_section(CheckpointSection::BUDDY);
+    out.put(total_size_);
+    out.put(max_order_);
+    out.put(used_memory_);
+    out.put(total_alloc_requests_);
+    out.put(successful_allocs_);
+    out.put(failed_allocs_);
+    out.put(invalid_frees_);
+    out.put(aligned_allocs_);
+    out.put(reallocs_);
+    out.put(reallocs_in_place_);
+    out.put(realloc_bytes_copied_);
+    out.put(batches_);
+    out.put(batched_requests_);
+
+    out.put(static_cast<std::uint64_t>(zones_.size()));
+    for (const auto &zone : zones_) {
+        out.put(zone.type);
+        out.put(zone.start);
+        out.put(zone.size);
+        out.put(zone.used);
+        out.put(zone.wmark_min);
+        out.put(zone.wmark_low);
+        out.put(zone.wmark_high);
+        out.put(zone.allocs);
+        out.put(zone.fallback_allocs);
+        out.put(zone.kswapd_wakeups);
+        out.put(zone.failed);
+        for (const auto &list : zone.free_lists) {
+            out.put(static_cast<std::uint64_t>(list.size()));
+            for (auto addr : list)
+                out.put(addr);
+        }
+    }
+    allocated_.save(out, [](CheckpointWriter &w, const std::pair<std::size_t, int> &block) {
+        w.put(block.first);
+        w.put(block.second);
+    });
+}
+
+bool BuddyAllocator::load(CheckpointReader &in) {
+    if (!in.expect_section(CheckpointSection::BUDDY))
+        return false;
+
+    in.get(total_size_);
+    in.get(max_order_);
+    in.get(used_memory_);
+    in.get(total_alloc_requests_);
+    in.get(successful_allocs_);
+    in.get(failed_allocs_);
+    in.get(invalid_frees_);
+    in.get(aligned_allocs_);
+    in.get(reallocs_);
+    in.get(reallocs_in_place_);
+    in.get(realloc_bytes_copied_);
+    in.get(batches_);
+    in.get(batched_requests_);
+    std::uint64_t zones = 0;
+    if (!in.get(zones) || max_order_ < 0 || max_order_ > 63 || zones > 3)
+        return false;
+
+    zones_.clear();
+    zones_.resize(zones);
+    for (auto &zone : zones_) {
+        in.get(zone.type);
+        in.get(zone.start);
+        in.get(zone.size);
+        in.get(zone.used);
+        in.get(zone.wmark_min);
+        in.get(zone.wmark_low);
+        in.get(zone.wmark_high);
+        in.get(zone.allocs);
+        in.get(zone.fallback_allocs);
+        in.get(zone.kswapd_wakeups);
+        in.get(zone.failed);
+        zone.free_lists.resize(max_order_ + 1);
+        for (auto &list : zone.free_lists) {
+            std::uint64_t count = 0;
+            if (!in.get(count))
+                return false;
+            for (std::uint64_t i = 0; i < count; i++) {
+                std::size_t addr = 0;
+                if (!in.get(addr))
+                    return false;
+                list.push_back(addr);
+            }
+        }
+    }
+    return allocated_.load(in, [](CheckpointReader &r, std::pair<std::size_t, int> &block) {
+        return r.get(block.first) && r.get(block.second);
+    });
+}
@@ -1,7 +1,14 @@
 #include "cache.h"
+#include "fixed_cache.h"
+#include "cache_partition.h"
+#include "perf_counters.h"
 #include <iostream>
 #include <cmath>
 
+namespace {
+constexpr std::size_t NO_BLOCK = ~std::size_t(0);
+}
+
 
 Cache::Cache()
     : cache_size_(0),
@@ -11,7 +18,20 @@ Cache::Cache()
       offset_bits_(0),
       index_bits_(0),
       hits_(0),
-      misses_(0) {}
+      misses_(0),
+      type_hits_{0, 0, 0},
+      type_misses_{0, 0, 0},
+      classify_(false),
+      compulsory_(0),
+      capacity_(0),
+      conflict_(0),
+      victim_entries_(0),
+      victim_hits_(0),
+      tenant_(0) {}
+
+Cache::~Cache() = default;
+Cache::Cache(Cache &&) = default;
+Cache &Cache::operator=(Cache &&) = default;
 
 
 //Helpers 
@@ -34,7 +54,8 @@ std::size_t Cache::extract_tag(std::size_t address) const {
 bool Cache::init(const std::string &name,
                  std::size_t cache_size,
                  std::size_t block_size,
-                 std::size_t associativity) {
+                 std::size_t associativity,
+                 bool specialize) {
 
     if (cache_size == 0 || block_size == 0 || associativity == 0) {
         std::cout << "Invalid cache parameters\n";
@@ -67,18 +88,225 @@ bool Cache::init(const std::string &name,
     index_bits_  = static_cast<std::size_t>(std::log2(num_sets_));
 
     sets_.clear();
-    sets_.resize(num_sets_);
+    //masks depend on the geometry, a new one starts unpartitioned
+    partition_.reset();
+    kernel_ = specialize ? make_cache_kernel(block_size_, num_sets_, associativity_) : nullptr;
+    if (!kernel_)
+        sets_.resize(num_sets_);
 
     hits_ = 0;
     misses_ = 0;
+    for (int t = 0; t < 3; t++)
+        type_hits_[t] = type_misses_[t] = 0;
+    //classification and victim cache stay configured, their contents restart
+    clear_analysis();
 
     return true;
 }
 
 
 //Access
-bool Cache::access(std::size_t address) {
+bool Cache::access(std::size_t address, AccessType type) {
+    PERF_SCOPE(CACHE_ACCESS);
+    return reference(address, true, type);
+}
+
+bool Cache::warm(std::size_t address) {
+    return reference(address, false, AccessType::READ);
+}
+
+bool Cache::reference(std::size_t address, bool record, AccessType type) {
+    std::size_t evicted = NO_BLOCK;
+    bool hit = lookup_fill(address, victim_entries_ ? &evicted : nullptr);
+    if (classify_)
+        classify(address >> offset_bits_, hit, record);
+    if (partition_) {
+        partition_->observe(tenant_, extract_index(address), extract_tag(address));
+        if (record)
+            partition_->record(tenant_, hit);
+    }
+
+    if (hit) {
+        if (record) {
+            hits_++;
+            type_hits_[static_cast<int>(type)]++;
+        }
+        return true;
+    }
+    if (record) {
+        misses_++;
+        type_misses_[static_cast<int>(type)]++;
+    }
+
+    //a victim hit is served by this level, the main cache still missed
+    if (victim_entries_ && victim_exchange(address >> offset_bits_, evicted)) {
+        if (record) victim_hits_++;
+        return true;
+    }
+    return false;
+}
+
+void Cache::classify(std::size_t block, bool hit, bool record) {
+    bool first_touch = touched_.insert(block).second;
+
+    auto it = shadow_.find(block);
+    bool shadow_hit = it != shadow_.end();
+    if (shadow_hit) {
+        shadow_lru_.splice(shadow_lru_.begin(), shadow_lru_, it->second);
+    } else {
+        shadow_lru_.push_front(block);
+        shadow_[block] = shadow_lru_.begin();
+        if (shadow_lru_.size() > cache_size_ / block_size_) {
+            shadow_.erase(shadow_lru_.back());
+            shadow_lru_.pop_back();
+        }
+    }
+
+    if (hit || !record)
+        return;
+    if (first_touch)
+        compulsory_++;
+    else if (!shadow_hit)
+        capacity_++;
+    else
+        conflict_++;
+}
+
+bool Cache::victim_exchange(std::size_t block, std::size_t evicted_block) {
+    bool found = false;
+    for (auto it = victim_.begin(); it != victim_.end(); ++it) {
+        if (*it == block) {
+            victim_.erase(it);
+            found = true;
+            break;
+        }
+    }
+    if (evicted_block != NO_BLOCK) {
+        victim_.push_back(evicted_block);
+        if (victim_.size() > victim_entries_)
+            victim_.pop_front();
+    }
+    return found;
+}
+
+void Cache::set_classification(bool enabled) {
+    classify_ = enabled;
+    touched_.clear();
+    shadow_lru_.clear();
+    shadow_.clear();
+    compulsory_ = capacity_ = conflict_ = 0;
+}
+
+void Cache::set_victim(std::size_t entries) {
+    victim_entries_ = entries;
+    victim_.clear();
+    victim_hits_ = 0;
+}
+
+void Cache::clear_analysis() {
+    set_classification(classify_);
+    set_victim(victim_entries_);
+}
+
+
+//Way partitioning
+void Cache::set_tenant(std::uint32_t stream) {
+    tenant_ = WayPartition::tenant_of(stream);
+}
+
+bool Cache::set_way_mask(std::uint32_t tenant, std::uint64_t mask) {
+    if (!start_partitioning())
+        return false;
+    return partition_->set_mask(tenant, mask);
+}
+
+bool Cache::set_ucp(std::size_t interval) {
+    if (!start_partitioning())
+        return false;
+    partition_->set_ucp(interval);
+    return true;
+}
+
+void Cache::clear_partitioning() {
+    //the lines stay in the runtime sets until the next init
+    partition_.reset();
+}
+
+bool Cache::start_partitioning() {
+    if (partition_)
+        return true;
+    if (num_sets_ == 0 || associativity_ > WayPartition::MAX_WAYS)
+        return false;
+
+    //lines present so far go to tenant 0, ways numbered in FIFO order
+    std::vector<std::deque<CacheLine>> sets(num_sets_);
+    std::vector<std::size_t> tags;
+    for (std::size_t s = 0; s < num_sets_; s++) {
+        set_tags(s, tags);
+        for (std::size_t i = 0; i < tags.size(); i++)
+            sets[s].push_back({true, tags[i], static_cast<std::uint8_t>(i), 0});
+    }
+    sets_ = std::move(sets);
+    kernel_.reset();
+
+    partition_.reset(new WayPartition(associativity_, num_sets_));
+    for (const auto &set : sets_) {
+        for (std::size_t i = 0; i < set.size(); i++)
+            partition_->filled(0);
+    }
+    return true;
+}
+
+bool Cache::lookup_fill_partitioned(std::size_t index, std::size_t tag, std::size_t *evicted_block) {
+    auto &set = sets_[index];
+
+    //a tenant hits in any way
+    std::uint64_t used = 0;
+    for (const auto &line : set) {
+        if (line.valid && line.tag == tag)
+            return true;
+        used |= std::uint64_t(1) << line.way;
+    }
+
+    //first free way of the mask, otherwise the oldest line inside the mask
+    std::uint64_t mask = partition_->mask(tenant_);
+    std::uint64_t free = mask & ~used;
+    std::uint8_t way = 0;
+    if (free) {
+        while (!(free & (std::uint64_t(1) << way)))
+            way++;
+    } else {
+        for (auto it = set.begin(); it != set.end(); ++it) {
+            if (mask & (std::uint64_t(1) << it->way)) {
+                if (evicted_block)
+                    *evicted_block = (it->tag << index_bits_) | index;
+                partition_->evicted(it->owner);
+                way = it->way;
+                set.erase(it);
+                break;
+            }
+        }
+    }
+
+    set.push_back({true, tag, way, static_cast<std::uint8_t>(tenant_)});
+    partition_->filled(tenant_);
+    return false;
+}
+
+bool Cache::lookup_fill(std::size_t address, std::size_t *evicted_block) {
     std::size_t index = extract_index(address);
+
+    if (partition_)
+        return lookup_fill_partitioned(index, extract_tag(address), evicted_block);
+
+    if (kernel_) {
+        std::size_t evicted_tag = NO_BLOCK;
+        bool hit = kernel_->lookup_fill(address, evicted_block ? &evicted_tag : nullptr);
+        if (evicted_block)
+            *evicted_block = (evicted_tag == NO_BLOCK) ? NO_BLOCK : (evicted_tag << index_bits_) | index;
+        return hit;
+    }
+
     std::size_t tag   = extract_tag(address);
 
     auto &set = sets_[index];
@@ -86,44 +314,76 @@ bool Cache::access(std::size_t address) {
     //Check for hit
     for (const auto &line : set) {
         if (line.valid && line.tag == tag) {
-            hits_++;
             return true;
         }
     }
 
-    //Miss
-    misses_++;
-
     //FIFO eviction if set is full
     if (set.size() >= associativity_) {
+        if (evicted_block)
+            *evicted_block = (set.front().tag << index_bits_) | index;
         set.pop_front();
     }
 
     //Insert new line
-    set.push_back({true, tag});
+    set.push_back({true, tag, 0, 0});
 
     return false;
 }
 
 
+//Tags of one set, oldest first
+void Cache::set_tags(std::size_t set, std::vector<std::size_t> &tags) const {
+    if (kernel_) {
+        kernel_->set_lines(set, tags);
+        return;
+    }
+    tags.clear();
+    for (const auto &line : sets_[set])
+        tags.push_back(line.tag);
+}
+
+
 //Reset
 void Cache::reset() {
     for (auto &set : sets_) {
         set.clear();
     }
+    if (kernel_)
+        kernel_->clear();
     hits_ = 0;
     misses_ = 0;
+    for (int t = 0; t < 3; t++)
+        type_hits_[t] = type_misses_[t] = 0;
+    clear_analysis();
+    if (partition_)
+        partition_->clear();
 }
 
 
 //Dump
 void Cache::dump() const {
     std::cout << name_ << " Cache Contents:\n";
+    std::vector<std::size_t> tags;
     for (std::size_t i = 0; i < num_sets_; ++i) {
         std::cout << "Set " << i << ": ";
-        for (const auto &line : sets_[i]) {
-            std::cout << "[T=" << line.tag << "] ";
+        if (partition_) {
+            //way and owning tenant of every line
+            for (const auto &line : sets_[i])
+                std::cout << "[T=" << line.tag << " W=" << int(line.way) << " O=" << int(line.owner) << "] ";
+            std::cout << "\n";
+            continue;
         }
+        set_tags(i, tags);
+        for (std::size_t tag : tags) {
+            std::cout << "[T=" << tag << "] ";
+        }
+        std::cout << "\n";
+    }
+    if (victim_entries_) {
+        std::cout << "Victim cache (blocks): ";
+        for (std::size_t block : victim_)
+            std::cout << "[B=" << block << "] ";
         std::cout << "\n";
     }
 }
@@ -138,4 +398,197 @@ void Cache::stats() const {
     std::cout << "Hits: " << hits_ << "\n";
     std::cout << "Misses: " << misses_ << "\n";
     std::cout << "Hit Rate: " << hit_rate * 100 << "%\n";
+    if (kernel_)
+        std::cout << "Specialized geometry: " << block_size_ << "B x " << num_sets_
+                  << " sets x " << associativity_ << " ways\n";
+    if (classify_) {
+        std::cout << "Miss classes: compulsory " << compulsory_ << ", capacity " << capacity_
+                  << ", conflict " << conflict_ << "\n";
+    }
+    if (victim_entries_) {
+        std::cout << "Victim cache (" << victim_entries_ << " entries): hits " << victim_hits_
+                  << ", " << (misses_ ? 100.0 * victim_hits_ / misses_ : 0.0) << "% of misses recovered\n";
+    }
+    if (partition_)
+        partition_->stats(cache_size_ / block_size_);
+
+    //per-type breakdown only once typed references were seen
+    const char *names[] = {"Reads", "Writes", "Fetches"};
+    std::size_t typed = hits(AccessType::WRITE) + misses(AccessType::WRITE) +
+                        hits(AccessType::IFETCH) + misses(AccessType::IFETCH);
+    if (typed == 0)
+        return;
+    for (int t = 0; t < 3; t++) {
+        std::size_t count = type_hits_[t] + type_misses_[t];
+        std::cout << names[t] << ": " << type_hits_[t] << " hits, " << type_misses_[t] << " misses";
+        if (count > 0)
+            std::cout << " (" << 100.0 * type_hits_[t] / count << "%)";
+        std::cout << "\n";
+    }
+}
+
+
+//Checkpoint
+void Cache::save(CheckpointWriter &out) const {
+    out.begin_section(CheckpointSection::CACHE);
+    out.put_string(name_);
+    out.put(cache_size_);
+    out.put(block_size_);
+    out.put(associativity_);
+    out.put(static_cast<std::uint8_t>(kernel_ != nullptr));
+    out.put(hits_);
+    out.put(misses_);
+    out.put(type_hits_);
+    out.put(type_misses_);
+
+    std::vector<std::size_t> tags;
+    for (std::size_t i = 0; i < num_sets_; i++) {
+        set_tags(i, tags);
+        out.put(static_cast<std::uint64_t>(tags.size()));
+        for (std::size_t tag : tags) {
+            out.put(static_cast<std::uint8_t>(1));
+            out.put(tag);
+        }
+    }
+
+    //analysis state, shadow in MRU order
+    out.put(static_cast<std::uint8_t>(classify_));
+    out.put(compulsory_);
+    out.put(capacity_);
+    out.put(conflict_);
+    out.put(static_cast<std::uint64_t>(touched_.size()));
+    for (std::size_t block : touched_)
+        out.put(block);
+    out.put(static_cast<std::uint64_t>(shadow_lru_.size()));
+    for (std::size_t block : shadow_lru_)
+        out.put(block);
+
+    out.put(victim_entries_);
+    out.put(victim_hits_);
+    out.put(static_cast<std::uint64_t>(victim_.size()));
+    for (std::size_t block : victim_)
+        out.put(block);
+
+    //partitioning: policy state, then way and owner of every line above
+    out.put(tenant_);
+    out.put(static_cast<std::uint8_t>(partition_ != nullptr));
+    if (!partition_)
+        return;
+    partition_->save(out);
+    for (const auto &set : sets_) {
+        for (const auto &line : set) {
+            out.put(line.way);
+            out.put(line.owner);
+        }
+    }
+}
+
+bool Cache::load(CheckpointReader &in) {
+    if (!in.expect_section(CheckpointSection::CACHE))
+        return false;
+
+    std::string name;
+    std::size_t cache_size = 0, block_size = 0, associativity = 0;
+    std::uint8_t specialized = 0;
+    std::size_t hits = 0, misses = 0;
+    std::size_t type_hits[3], type_misses[3];
+    in.get_string(name);
+    in.get(cache_size);
+    in.get(block_size);
+    in.get(associativity);
+    in.get(specialized);
+    in.get(hits);
+    in.get(misses);
+    in.get(type_hits);
+    //the kernel choice is restored too, so a fork runs on the same cache code
+    if (!in.get(type_misses) || !init(name, cache_size, block_size, associativity, specialized != 0))
+        return false;
+
+    std::vector<std::size_t> tags;
+    for (std::size_t s = 0; s < num_sets_; s++) {
+        std::uint64_t count = 0;
+        if (!in.get(count) || count > associativity_)
+            return false;
+        tags.clear();
+        for (std::uint64_t i = 0; i < count; i++) {
+            std::uint8_t valid = 0;
+            std::size_t tag = 0;
+            if (!in.get(valid) || !in.get(tag))
+                return false;
+            //lines are only ever inserted valid
+            if (valid)
+                tags.push_back(tag);
+        }
+        if (kernel_)
+            kernel_->load_set(s, tags);
+        else
+            for (std::size_t tag : tags)
+                sets_[s].push_back({true, tag, 0, 0});
+    }
+
+    std::uint8_t classify = 0;
+    std::uint64_t count = 0;
+    in.get(classify);
+    set_classification(classify != 0);
+    in.get(compulsory_);
+    in.get(capacity_);
+    in.get(conflict_);
+    if (!in.get(count))
+        return false;
+    for (std::uint64_t i = 0; i < count; i++) {
+        std::size_t block = 0;
+        if (!in.get(block))
+            return false;
+        touched_.insert(block);
+    }
+    if (!in.get(count) || count > cache_size_ / block_size_)
+        return false;
+    for (std::uint64_t i = 0; i < count; i++) {
+        std::size_t block = 0;
+        if (!in.get(block))
+            return false;
+        shadow_lru_.push_back(block);
+        shadow_[block] = std::prev(shadow_lru_.end());
+    }
+
+    std::size_t victim_entries = 0, victim_hits = 0;
+    in.get(victim_entries);
+    in.get(victim_hits);
+    set_victim(victim_entries);
+    victim_hits_ = victim_hits;
+    if (!in.get(count) || count > victim_entries_)
+        return false;
+    for (std::uint64_t i = 0; i < count; i++) {
+        std::size_t block = 0;
+        if (!in.get(block))
+            return false;
+        victim_.push_back(block);
+    }
+
+    std::uint8_t partitioned = 0;
+    in.get(tenant_);
+    if (!in.get(partitioned) || tenant_ >= WayPartition::MAX_TENANTS)
+        return false;
+    if (partitioned) {
+        if (!start_partitioning() || !partition_->load(in))
+            return false;
+        for (auto &set : sets_) {
+            std::uint64_t used = 0;
+            for (auto &line : set) {
+                if (!in.get(line.way) || !in.get(line.owner) || line.way >= associativity_ ||
+                    line.owner >= WayPartition::MAX_TENANTS || (used & (std::uint64_t(1) << line.way)))
+                    return false;
+                used |= std::uint64_t(1) << line.way;
+                partition_->filled(line.owner);
+            }
+        }
+    }
+
+    hits_ = hits;
+    misses_ = misses;
+    for (int t = 0; t < 3; t++) {
+        type_hits_[t] = type_hits[t];
+        type_misses_[t] = type_misses[t];
+    }
+    return true;
 }
\ No newline at end of file
@@ -0,0 +1,208 @@
+#include "cache_partition.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+//Sets sampled by the utility monitors (UCP uses 32)
+constexpr std::size_t MONITORED_SETS = 32;
+
+void put_counts(CheckpointWriter &out, const std::vector<std::uint64_t> &values) {
+    out.put_bytes(values.data(), values.size() * sizeof(std::uint64_t));
+}
+
+bool get_counts(CheckpointReader &in, std::vector<std::uint64_t> &values) {
+    return in.get_bytes(values.data(), values.size() * sizeof(std::uint64_t));
+}
+}
+
+
+WayPartition::WayPartition(std::size_t ways, std::size_t sets)
+    : ways_(ways),
+      stride_(sets > MONITORED_SETS ? sets / MONITORED_SETS : 1),
+      sampled_(sets > MONITORED_SETS ? MONITORED_SETS : sets),
+      masks_(MAX_TENANTS, 0),
+      hits_(MAX_TENANTS, 0),
+      misses_(MAX_TENANTS, 0),
+      occupancy_(MAX_TENANTS, 0),
+      interval_(0),
+      countdown_(0),
+      repartitions_(0),
+      shadow_(MAX_TENANTS * sampled_),
+      way_hits_(MAX_TENANTS * ways, 0),
+      interval_refs_(MAX_TENANTS, 0) {
+    std::fill(masks_.begin(), masks_.end(), full_mask());
+}
+
+std::uint64_t WayPartition::full_mask() const {
+    return (ways_ >= 64) ? ~std::uint64_t(0) : (std::uint64_t(1) << ways_) - 1;
+}
+
+bool WayPartition::set_mask(std::uint32_t tenant, std::uint64_t mask) {
+    if (tenant >= MAX_TENANTS || mask == 0 || (mask & ~full_mask()))
+        return false;
+    //contiguous: shifting out the trailing zeros leaves 2^n - 1
+    std::uint64_t bits = mask;
+    while (!(bits & 1))
+        bits >>= 1;
+    if (bits & (bits + 1))
+        return false;
+    masks_[tenant] = mask;
+    return true;
+}
+
+void WayPartition::set_ucp(std::size_t interval) {
+    interval_ = interval;
+    countdown_ = interval;
+}
+
+
+//Utility monitor
+void WayPartition::observe(std::uint32_t tenant, std::size_t set, std::size_t tag) {
+    if (interval_ == 0)
+        return;
+
+    interval_refs_[tenant]++;
+    if (set % stride_ == 0 && set / stride_ < sampled_) {
+        std::vector<std::size_t> &stack = shadow_[tenant * sampled_ + set / stride_];
+        auto it = std::find(stack.begin(), stack.end(), tag);
+        if (it != stack.end()) {
+            way_hits_[tenant * ways_ + (it - stack.begin())]++;
+            stack.erase(it);
+        } else if (stack.size() == ways_) {
+            stack.pop_back();
+        }
+        stack.insert(stack.begin(), tag);
+    }
+
+    if (--countdown_ == 0) {
+        repartition();
+        countdown_ = interval_;
+    }
+}
+
+//Lookahead allocation: every tenant seen gets one way, the rest goes out in
+//steps to the tenant with the highest hits gained per extra way
+void WayPartition::repartition() {
+    std::vector<std::uint32_t> active;
+    for (std::uint32_t t = 0; t < MAX_TENANTS; t++) {
+        if (interval_refs_[t] > 0)
+            active.push_back(t);
+    }
+
+    if (!active.empty() && active.size() <= ways_) {
+        std::vector<std::size_t> alloc(MAX_TENANTS, 1);
+        std::size_t balance = ways_ - active.size();
+
+        while (balance > 0) {
+            double best_utility = -1.0;
+            std::uint32_t best_tenant = active[0];
+            std::size_t best_ways = 1;
+            for (std::uint32_t t : active) {
+                std::uint64_t gain = 0;
+                for (std::size_t k = 1; k <= balance && alloc[t] + k <= ways_; k++) {
+                    gain += way_hits_[t * ways_ + alloc[t] + k - 1];
+                    double utility = static_cast<double>(gain) / k;
+                    if (utility > best_utility) {
+                        best_utility = utility;
+                        best_tenant = t;
+                        best_ways = k;
+                    }
+                }
+            }
+            alloc[best_tenant] += best_ways;
+            balance -= best_ways;
+        }
+
+        //contiguous masks, in tenant order from way 0
+        std::size_t first = 0;
+        for (std::uint32_t t : active) {
+            std::uint64_t bits = (alloc[t] >= 64) ? ~std::uint64_t(0) : (std::uint64_t(1) << alloc[t]) - 1;
+            masks_[t] = bits << first;
+            first += alloc[t];
+        }
+        repartitions_++;
+    }
+
+    //halve the monitors so recent behaviour dominates
+    for (std::uint64_t &h : way_hits_)
+        h /= 2;
+    std::fill(interval_refs_.begin(), interval_refs_.end(), 0);
+}
+
+
+void WayPartition::clear() {
+    std::fill(hits_.begin(), hits_.end(), 0);
+    std::fill(misses_.begin(), misses_.end(), 0);
+    std::fill(occupancy_.begin(), occupancy_.end(), 0);
+    std::fill(way_hits_.begin(), way_hits_.end(), 0);
+    std::fill(interval_refs_.begin(), interval_refs_.end(), 0);
+    for (auto &stack : shadow_)
+        stack.clear();
+    countdown_ = interval_;
+    repartitions_ = 0;
+}
+
+
+void WayPartition::stats(std::size_t lines) const {
+    std::cout << "Way partitioning: " << ways_ << " ways";
+    if (interval_)
+        std::cout << ", UCP every " << interval_ << " references (" << repartitions_ << " repartitions)";
+    std::cout << "\n";
+
+    for (std::uint32_t t = 0; t < MAX_TENANTS; t++) {
+        std::uint64_t total = hits_[t] + misses_[t];
+        if (total == 0 && occupancy_[t] == 0 && masks_[t] == full_mask())
+            continue;
+        std::cout << "Tenant " << t << ": mask 0x" << std::hex << masks_[t] << std::dec
+                  << ", " << occupancy_[t] << " lines (" << (lines ? 100.0 * occupancy_[t] / lines : 0.0) << "%)"
+                  << ", " << hits_[t] << " hits, " << misses_[t] << " misses";
+        if (total > 0)
+            std::cout << " (" << 100.0 * hits_[t] / total << "%)";
+        std::cout << "\n";
+    }
+}
+
+
+//Checkpoint
+void WayPartition::save(CheckpointWriter &out) const {
+    out.put(interval_);
+    out.put(countdown_);
+    out.put(repartitions_);
+    put_counts(out, masks_);
+    put_counts(out, hits_);
+    put_counts(out, misses_);
+    put_counts(out, way_hits_);
+    put_counts(out, interval_refs_);
+    for (const auto &stack : shadow_) {
+        out.put(static_cast<std::uint64_t>(stack.size()));
+        for (std::size_t tag : stack)
+            out.put(tag);
+    }
+}
+
+bool WayPartition::load(CheckpointReader &in) {
+    clear();
+    in.get(interval_);
+    in.get(countdown_);
+    in.get(repartitions_);
+    if (!get_counts(in, masks_) || !get_counts(in, hits_) || !get_counts(in, misses_) ||
+        !get_counts(in, way_hits_) || !get_counts(in, interval_refs_))
+        return false;
+    if (interval_ && (countdown_ == 0 || countdown_ > interval_))
+        return false;
+    for (std::uint64_t mask : masks_) {
+        if (mask == 0 || (mask & ~full_mask()))
+            return false;
+    }
+    for (auto &stack : shadow_) {
+        std::uint64_t count = 0;
+        if (!in.get(count) || count > ways_)
+            return false;
+        stack.resize(count);
+        for (std::size_t &tag : stack) {
+            if (!in.get(tag))
+                return false;
+        }
+    }
+    return true;
+}
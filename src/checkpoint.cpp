@@ -0,0 +1,157 @@
+#include "checkpoint.h"
+#include <cstdio>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+const char MAGIC[8] = {'M', 'E', 'M', 'S', 'I', 'M', 'C', 'K'};
+constexpr std::uint32_t VERSION = 14;
+}
+
+
+//Writer
+
+CheckpointWriter::CheckpointWriter() {
+    put_bytes(MAGIC, sizeof(MAGIC));
+    put(VERSION);
+}
+
+void CheckpointWriter::put_bytes(const void *data, std::size_t size) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    buffer_.insert(buffer_.end(), bytes, bytes + size);
+}
+
+void CheckpointWriter::put_string(const std::string &value) {
+    put(static_cast<std::uint32_t>(value.size()));
+    put_bytes(value.data(), value.size());
+}
+
+void CheckpointWriter::begin_section(CheckpointSection section) {
+    put(static_cast<std::uint32_t>(section));
+}
+
+bool CheckpointWriter::write_file(const std::string &path) const {
+    std::FILE *f = std::fopen(path.c_str(), "wb");
+    if (!f)
+        return false;
+    bool ok = std::fwrite(buffer_.data(), 1, buffer_.size(), f) == buffer_.size();
+    ok = (std::fclose(f) == 0) && ok;
+    return ok;
+}
+
+
+//Reader
+
+CheckpointReader::CheckpointReader()
+    : data_(nullptr),
+      size_(0),
+      pos_(0),
+      failed_(false),
+      mapped_(false) {}
+
+CheckpointReader::~CheckpointReader() {
+    close();
+}
+
+bool CheckpointReader::open(const std::string &path) {
+    close();
+
+#ifdef __linux__
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+        return false;
+
+    data_ = static_cast<const unsigned char *>(p);
+    size_ = static_cast<std::size_t>(st.st_size);
+    mapped_ = true;
+#else
+    std::FILE *f = std::fopen(path.c_str(), "rb");
+    if (!f)
+        return false;
+    std::fseek(f, 0, SEEK_END);
+    long len = std::ftell(f);
+    std::fseek(f, 0, SEEK_SET);
+    if (len <= 0) {
+        std::fclose(f);
+        return false;
+    }
+    unsigned char *copy = new unsigned char[len];
+    std::size_t got = std::fread(copy, 1, len, f);
+    std::fclose(f);
+    data_ = copy;
+    size_ = got;
+#endif
+
+    pos_ = 0;
+    failed_ = false;
+
+    char magic[sizeof(MAGIC)];
+    std::uint32_t version = 0;
+    if (!get_bytes(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        !get(version) || version != VERSION) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void CheckpointReader::close() {
+    if (data_) {
+#ifdef __linux__
+        if (mapped_)
+            munmap(const_cast<unsigned char *>(data_), size_);
+#else
+        delete[] data_;
+#endif
+    }
+    data_ = nullptr;
+    size_ = 0;
+    pos_ = 0;
+    mapped_ = false;
+}
+
+bool CheckpointReader::get_bytes(void *data, std::size_t size) {
+    if (failed_ || size > size_ - pos_) {
+        failed_ = true;
+        return false;
+    }
+    std::memcpy(data, data_ + pos_, size);
+    pos_ += size;
+    return true;
+}
+
+bool CheckpointReader::get_string(std::string &value) {
+    std::uint32_t len = 0;
+    if (!get(len) || len > size_ - pos_) {
+        failed_ = true;
+        return false;
+    }
+    value.assign(reinterpret_cast<const char *>(data_ + pos_), len);
+    pos_ += len;
+    return true;
+}
+
+bool CheckpointReader::expect_section(CheckpointSection section) {
+    std::uint32_t tag = 0;
+    if (!get(tag) || tag != static_cast<std::uint32_t>(section)) {
+        failed_ = true;
+        return false;
+    }
+    return true;
+}
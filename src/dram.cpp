@@ -0,0 +1,443 @@
+#include "dram.h"
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+namespace {
+constexpr std::uint64_t NEVER = std::numeric_limits<std::uint64_t>::max();
+constexpr std::size_t HISTOGRAM_CYCLES = 4096;
+
+const char *FIELD_NAMES[] = {"Ro", "Ra", "Ba", "Ch", "Co"};
+
+bool is_power_of_two(std::size_t x) {
+    return x > 0 && (x & (x - 1)) == 0;
+}
+
+std::size_t log2_of(std::size_t x) {
+    std::size_t bits = 0;
+    while (x > 1) {
+        x >>= 1;
+        bits++;
+    }
+    return bits;
+}
+}
+
+
+Dram::Dram()
+    : ranks_(0),
+      banks_(0),
+      row_bytes_(0),
+      rows_(0),
+      bits_{0, 0, 0, 0, 0},
+      policy_(PagePolicy::OPEN),
+      scheduler_(DramScheduler::FR_FCFS),
+      t_cl_(14),
+      t_rcd_(14),
+      t_rp_(14),
+      t_burst_(4),
+      queue_depth_(16),
+      gap_(4),
+      clock_(0),
+      requests_(0),
+      row_hits_(0),
+      row_empty_(0),
+      row_conflicts_(0),
+      reordered_(0),
+      stalls_(0),
+      total_latency_(0),
+      max_latency_(0),
+      last_outcome_(RowOutcome::EMPTY),
+      last_latency_(0) {}
+
+
+//Initialization
+bool Dram::init(std::size_t channels, std::size_t ranks, std::size_t banks,
+                std::size_t row_bytes, std::size_t rows) {
+    if (!is_power_of_two(channels) || !is_power_of_two(ranks) || !is_power_of_two(banks) ||
+        !is_power_of_two(rows) || !is_power_of_two(row_bytes) || row_bytes < BURST_BYTES) {
+        std::cout << "DRAM channels, ranks, banks, rows and row size must be powers of two (rows >= 64 bytes)\n";
+        return false;
+    }
+
+    ranks_ = ranks;
+    banks_ = banks;
+    row_bytes_ = row_bytes;
+    rows_ = rows;
+    bits_[ROW] = log2_of(rows);
+    bits_[RANK] = log2_of(ranks);
+    bits_[BANK] = log2_of(banks);
+    bits_[CHANNEL] = log2_of(channels);
+    bits_[COLUMN] = log2_of(row_bytes / BURST_BYTES);
+
+    channels_.assign(channels, Channel{});
+    set_mapping("RoRaBaChCo");
+    reset();
+    return true;
+}
+
+bool Dram::set_mapping(const std::string &scheme) {
+    if (scheme.size() != 2 * FIELDS)
+        return false;
+
+    std::vector<Field> order;
+    bool seen[FIELDS] = {false, false, false, false, false};
+    for (std::size_t i = 0; i < scheme.size(); i += 2) {
+        std::string name = scheme.substr(i, 2);
+        int field = -1;
+        for (int f = 0; f < FIELDS; f++) {
+            if (name == FIELD_NAMES[f])
+                field = f;
+        }
+        if (field < 0 || seen[field])
+            return false;
+        seen[field] = true;
+        order.push_back(static_cast<Field>(field));
+    }
+
+    order_ = order;
+    return true;
+}
+
+bool Dram::set_timing(std::uint32_t cl, std::uint32_t rcd, std::uint32_t rp, std::uint32_t burst) {
+    if (cl == 0 || rcd == 0 || rp == 0 || burst == 0)
+        return false;
+    t_cl_ = cl;
+    t_rcd_ = rcd;
+    t_rp_ = rp;
+    t_burst_ = burst;
+    return true;
+}
+
+bool Dram::set_queue(std::size_t depth, std::size_t gap) {
+    if (depth == 0)
+        return false;
+    drain();
+    queue_depth_ = depth;
+    gap_ = gap;
+    return true;
+}
+
+void Dram::reset() {
+    for (Channel &channel : channels_) {
+        channel.queue.clear();
+        channel.banks.assign(ranks_ * banks_, Bank{false, 0, 0, 0});
+        channel.cmd_free = 0;
+        channel.bus_free = 0;
+    }
+    clock_ = 0;
+    requests_ = row_hits_ = row_empty_ = row_conflicts_ = 0;
+    reordered_ = stalls_ = 0;
+    total_latency_ = max_latency_ = 0;
+    latency_hist_.assign(HISTOGRAM_CYCLES + 1, 0);
+    last_outcome_ = RowOutcome::EMPTY;
+    last_latency_ = 0;
+}
+
+
+//Address mapping: burst offset lowest, then the scheme from its last field up
+void Dram::decode(std::size_t paddr, std::size_t fields[FIELDS]) const {
+    std::size_t rest = paddr / BURST_BYTES;
+    for (auto it = order_.rbegin(); it != order_.rend(); ++it) {
+        std::size_t width = bits_[*it];
+        fields[*it] = rest & ((std::size_t(1) << width) - 1);
+        rest >>= width;
+    }
+}
+
+
+//Requests
+void Dram::access(std::size_t paddr) {
+    std::size_t fields[FIELDS];
+    decode(paddr, fields);
+    Channel &target = channels_[fields[CHANNEL]];
+
+    //the controllers keep working until this request arrives
+    for (Channel &channel : channels_)
+        issue_until(channel, clock_, false);
+
+    //a full queue holds the requester back until a slot frees up
+    if (target.queue.size() >= queue_depth_) {
+        stalls_++;
+        issue_until(target, NEVER, true);
+        clock_ = std::max(clock_, target.cmd_free);
+    }
+
+    target.queue.push_back({clock_, fields[RANK] * banks_ + fields[BANK], fields[ROW]});
+    clock_ += gap_;
+}
+
+void Dram::drain() {
+    for (Channel &channel : channels_) {
+        issue_until(channel, NEVER, false);
+        //the requester waited for the data
+        clock_ = std::max(clock_, channel.bus_free);
+    }
+}
+
+std::uint64_t Dram::ready_at(const Channel &channel, const Request &r) const {
+    return std::max(r.arrival, channel.banks[r.bank].ready);
+}
+
+std::size_t Dram::pick(const Channel &channel, std::uint64_t now) const {
+    if (scheduler_ == DramScheduler::FCFS)
+        return 0;
+
+    //first ready: the oldest row hit whose bank can take a command now
+    std::size_t oldest_ready = channel.queue.size();
+    for (std::size_t i = 0; i < channel.queue.size(); i++) {
+        const Request &r = channel.queue[i];
+        if (ready_at(channel, r) > now)
+            continue;
+        const Bank &bank = channel.banks[r.bank];
+        if (bank.open && bank.row == r.row)
+            return i;
+        if (oldest_ready == channel.queue.size())
+            oldest_ready = i;
+    }
+    return oldest_ready;
+}
+
+void Dram::issue_until(Channel &channel, std::uint64_t limit, bool force_one) {
+    while (!channel.queue.empty()) {
+        //earliest cycle any eligible request can start
+        std::uint64_t earliest = NEVER;
+        if (scheduler_ == DramScheduler::FCFS) {
+            earliest = ready_at(channel, channel.queue.front());
+        } else {
+            for (const Request &r : channel.queue)
+                earliest = std::min(earliest, ready_at(channel, r));
+        }
+        std::uint64_t now = std::max(channel.cmd_free, earliest);
+        if (now > limit)
+            return;
+
+        service(channel, pick(channel, now), now);
+        if (force_one)
+            return;
+    }
+}
+
+void Dram::service(Channel &channel, std::size_t index, std::uint64_t start) {
+    Request r = channel.queue[index];
+    channel.queue.erase(channel.queue.begin() + index);
+    if (index > 0)
+        reordered_++;
+
+    Bank &bank = channel.banks[r.bank];
+    std::uint64_t column = start;
+    RowOutcome outcome;
+    if (bank.open && bank.row == r.row) {
+        outcome = RowOutcome::HIT;
+        row_hits_++;
+    } else if (!bank.open) {
+        outcome = RowOutcome::EMPTY;
+        column += t_rcd_;
+        row_empty_++;
+    } else {
+        outcome = RowOutcome::CONFLICT;
+        column += t_rp_ + t_rcd_;
+        row_conflicts_++;
+        bank.conflicts++;
+    }
+
+    std::uint64_t data = std::max(column + t_cl_, channel.bus_free);
+    std::uint64_t done = data + t_burst_;
+    channel.bus_free = done;
+    channel.cmd_free = start + 1;
+
+    if (policy_ == PagePolicy::OPEN) {
+        bank.open = true;
+        bank.row = r.row;
+        bank.ready = column + t_burst_;
+    } else {
+        //auto-precharge once the burst is out
+        bank.open = false;
+        bank.ready = done + t_rp_;
+    }
+
+    std::uint64_t latency = done - r.arrival;
+    requests_++;
+    total_latency_ += latency;
+    max_latency_ = std::max(max_latency_, latency);
+    latency_hist_[std::min<std::uint64_t>(latency, HISTOGRAM_CYCLES)]++;
+    last_outcome_ = outcome;
+    last_latency_ = latency;
+}
+
+
+//Output
+double Dram::row_hit_rate() const {
+    return requests_ ? static_cast<double>(row_hits_) / requests_ : 0.0;
+}
+
+std::string Dram::mapping_name() const {
+    std::string name;
+    for (Field f : order_)
+        name += FIELD_NAMES[f];
+    return name;
+}
+
+void Dram::stats() const {
+    if (channels_.empty()) {
+        std::cout << "DRAM not initialized\n";
+        return;
+    }
+
+    std::cout << "DRAM Stats\n";
+    std::cout << "Geometry: " << channels_.size() << " channels x " << ranks_ << " ranks x "
+              << banks_ << " banks, " << rows_ << " rows of " << row_bytes_ << " bytes\n";
+    std::cout << "Mapping: " << mapping_name()
+              << ", " << (policy_ == PagePolicy::OPEN ? "open" : "closed") << " page"
+              << ", " << (scheduler_ == DramScheduler::FR_FCFS ? "FR-FCFS" : "FCFS")
+              << ", queue " << queue_depth_ << ", arrival gap " << gap_ << "\n";
+    std::cout << "Timing: tCL " << t_cl_ << ", tRCD " << t_rcd_ << ", tRP " << t_rp_
+              << ", tBURST " << t_burst_ << " cycles\n";
+    std::cout << "Requests: " << requests_ << "\n";
+    if (requests_ == 0)
+        return;
+
+    std::cout << "Row hits: " << row_hits_ << " (" << row_hit_rate() * 100 << "%)"
+              << ", row empty: " << row_empty_
+              << ", bank conflicts: " << row_conflicts_ << "\n";
+
+    //percentiles from the histogram
+    std::uint64_t targets[] = {(requests_ + 1) / 2, (requests_ * 95 + 99) / 100, (requests_ * 99 + 99) / 100};
+    std::uint64_t values[3] = {0, 0, 0};
+    std::uint64_t seen = 0;
+    int next = 0;
+    for (std::size_t cycles = 0; cycles < latency_hist_.size() && next < 3; cycles++) {
+        seen += latency_hist_[cycles];
+        while (next < 3 && seen >= targets[next])
+            values[next++] = cycles;
+    }
+    std::cout << "Latency: average " << (double)total_latency_ / requests_
+              << ", p50 " << values[0] << ", p95 " << values[1] << ", p99 " << values[2]
+              << ", max " << max_latency_ << " cycles\n";
+    std::cout << "Reordered by scheduler: " << reordered_ << ", queue-full stalls: " << stalls_ << "\n";
+
+    for (std::size_t c = 0; c < channels_.size(); c++) {
+        std::uint64_t conflicts = 0, worst = 0;
+        std::size_t worst_bank = 0;
+        for (std::size_t b = 0; b < channels_[c].banks.size(); b++) {
+            conflicts += channels_[c].banks[b].conflicts;
+            if (channels_[c].banks[b].conflicts > worst) {
+                worst = channels_[c].banks[b].conflicts;
+                worst_bank = b;
+            }
+        }
+        std::cout << "Channel " << c << ": bank conflicts " << conflicts;
+        if (worst > 0)
+            std::cout << ", most in rank " << worst_bank / banks_ << " bank " << worst_bank % banks_
+                      << " (" << worst << ")";
+        std::cout << "\n";
+    }
+}
+
+
+//Checkpoint
+void Dram::save(CheckpointWriter &out) const {
+    out.begin_section(CheckpointSection::DRAM);
+    out.put(static_cast<std::uint64_t>(channels_.size()));
+    out.put(ranks_);
+    out.put(banks_);
+    out.put(row_bytes_);
+    out.put(rows_);
+    out.put(static_cast<std::uint64_t>(order_.size()));
+    for (Field f : order_)
+        out.put(static_cast<std::uint8_t>(f));
+    out.put(policy_);
+    out.put(scheduler_);
+    out.put(t_cl_);
+    out.put(t_rcd_);
+    out.put(t_rp_);
+    out.put(t_burst_);
+    out.put(queue_depth_);
+    out.put(gap_);
+    out.put(clock_);
+
+    out.put(requests_);
+    out.put(row_hits_);
+    out.put(row_empty_);
+    out.put(row_conflicts_);
+    out.put(reordered_);
+    out.put(stalls_);
+    out.put(total_latency_);
+    out.put(max_latency_);
+    out.put_bytes(latency_hist_.data(), latency_hist_.size() * sizeof(std::uint64_t));
+
+    for (const Channel &channel : channels_) {
+        out.put(channel.cmd_free);
+        out.put(channel.bus_free);
+        for (const Bank &bank : channel.banks) {
+            out.put(static_cast<std::uint8_t>(bank.open));
+            out.put(bank.row);
+            out.put(bank.ready);
+            out.put(bank.conflicts);
+        }
+    }
+}
+
+bool Dram::load(CheckpointReader &in) {
+    if (!in.expect_section(CheckpointSection::DRAM))
+        return false;
+
+    std::uint64_t channels = 0, fields = 0;
+    std::size_t ranks = 0, banks = 0, row_bytes = 0, rows = 0;
+    in.get(channels);
+    in.get(ranks);
+    in.get(banks);
+    in.get(row_bytes);
+    in.get(rows);
+    if (!in.get(fields) || fields != FIELDS || !init(channels, ranks, banks, row_bytes, rows))
+        return false;
+
+    std::string scheme;
+    for (std::uint64_t i = 0; i < fields; i++) {
+        std::uint8_t f = 0;
+        if (!in.get(f) || f >= FIELDS)
+            return false;
+        scheme += FIELD_NAMES[f];
+    }
+    if (!set_mapping(scheme))
+        return false;
+
+    std::uint32_t cl = 0, rcd = 0, rp = 0, burst = 0;
+    in.get(policy_);
+    in.get(scheduler_);
+    in.get(cl);
+    in.get(rcd);
+    in.get(rp);
+    in.get(burst);
+    in.get(queue_depth_);
+    in.get(gap_);
+    in.get(clock_);
+    if (!set_timing(cl, rcd, rp, burst) || queue_depth_ == 0)
+        return false;
+
+    in.get(requests_);
+    in.get(row_hits_);
+    in.get(row_empty_);
+    in.get(row_conflicts_);
+    in.get(reordered_);
+    in.get(stalls_);
+    in.get(total_latency_);
+    in.get(max_latency_);
+    if (!in.get_bytes(latency_hist_.data(), latency_hist_.size() * sizeof(std::uint64_t)))
+        return false;
+
+    for (Channel &channel : channels_) {
+        in.get(channel.cmd_free);
+        in.get(channel.bus_free);
+        for (Bank &bank : channel.banks) {
+            std::uint8_t open = 0;
+            in.get(open);
+            in.get(bank.row);
+            in.get(bank.ready);
+            if (!in.get(bank.conflicts))
+                return false;
+            bank.open = open != 0;
+        }
+    }
+    return true;
+}
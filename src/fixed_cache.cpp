@@ -0,0 +1,47 @@
+#include "fixed_cache.h"
+#include <iostream>
+
+namespace {
+
+template <std::size_t BlockSize, std::size_t Sets, std::size_t Ways>
+std::unique_ptr<CacheKernel> make_kernel() {
+    return std::unique_ptr<CacheKernel>(new FixedCacheKernel<BlockSize, Sets, Ways>());
+}
+
+struct KernelEntry {
+    std::size_t block_size;
+    std::size_t sets;
+    std::size_t ways;
+    std::unique_ptr<CacheKernel> (*make)();
+};
+
+//Common production geometries (64 byte lines)
+const KernelEntry REGISTRY[] = {
+    {64, 64, 8, make_kernel<64, 64, 8>},        //32 KB L1
+    {64, 64, 4, make_kernel<64, 64, 4>},        //16 KB L1
+    {64, 128, 8, make_kernel<64, 128, 8>},      //64 KB L1
+    {64, 512, 8, make_kernel<64, 512, 8>},      //256 KB L2
+    {64, 1024, 16, make_kernel<64, 1024, 16>},  //1 MB L2
+    {64, 2048, 16, make_kernel<64, 2048, 16>},  //2 MB LLC slice
+    {64, 8192, 16, make_kernel<64, 8192, 16>},  //8 MB LLC
+};
+
+}
+
+
+std::unique_ptr<CacheKernel> make_cache_kernel(std::size_t block_size, std::size_t sets, std::size_t ways) {
+    for (const auto &entry : REGISTRY) {
+        if (entry.block_size == block_size && entry.sets == sets && entry.ways == ways)
+            return entry.make();
+    }
+    return nullptr;
+}
+
+void list_cache_kernels() {
+    std::cout << "Specialized cache geometries:\n";
+    for (const auto &entry : REGISTRY) {
+        std::cout << "  " << entry.block_size * entry.sets * entry.ways << " bytes, "
+                  << entry.block_size << " byte blocks, " << entry.ways << " ways ("
+                  << entry.sets << " sets)\n";
+    }
+}
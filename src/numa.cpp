@@ -0,0 +1,405 @@
+#include "numa.h"
+#include <iostream>
+
+NumaMemory::NumaMemory()
+    : node_size_(0),
+      policy_(NumaPolicy::LOCAL),
+      engine_(NumaEngine::PHYSICAL),
+      allocator_(AllocatorType::FIRST_FIT),
+      preferred_node_(0),
+      cpu_node_(0),
+      interleave_next_(0),
+      local_latency_(100),
+      remote_latency_(160),
+      total_latency_(0) {}
+
+
+//Initialization
+bool NumaMemory::init(std::size_t num_nodes, std::size_t node_size) {
+    if (num_nodes == 0 || node_size == 0) {
+        std::cout << "Invalid NUMA configuration\n";
+        return false;
+    }
+
+    nodes_.clear();
+    nodes_.resize(num_nodes);
+    node_size_ = node_size;
+
+    //buddy nodes take any size (decomposed into power of two blocks)
+    set_engine(engine_, allocator_);
+
+    preferred_node_ = 0;
+    cpu_node_ = 0;
+    interleave_next_ = 0;
+    total_latency_ = 0;
+    ids_.clear();
+    page_nodes_.clear();
+    return true;
+}
+
+
+//Configuration
+void NumaMemory::set_policy(NumaPolicy policy, std::size_t preferred_node) {
+    policy_ = policy;
+    if (policy == NumaPolicy::PREFERRED)
+        preferred_node_ = (preferred_node < nodes_.size()) ? preferred_node : 0;
+}
+
+//Switching engines starts every node with empty memory
+bool NumaMemory::set_engine(NumaEngine engine, AllocatorType type) {
+    for (auto &node : nodes_) {
+        if (engine == NumaEngine::BUDDY && !node.buddy.init(node_size_))
+            return false;
+        node.phys.init(node_size_);
+        node.phys.set_allocator(type);
+        node.allocations = 0;
+    }
+
+    engine_ = engine;
+    allocator_ = type;
+    ids_.clear();
+    return true;
+}
+
+bool NumaMemory::set_cpu_node(std::size_t node) {
+    if (node >= nodes_.size())
+        return false;
+    cpu_node_ = node;
+    return true;
+}
+
+void NumaMemory::set_latency(std::size_t local, std::size_t remote) {
+    local_latency_ = local;
+    remote_latency_ = remote;
+}
+
+
+//Placement helpers
+std::vector<std::size_t> NumaMemory::placement_order(std::size_t first) const {
+    std::vector<std::size_t> order;
+    for (std::size_t i = 0; i < nodes_.size(); i++)
+        order.push_back((first + i) % nodes_.size());
+    return order;
+}
+
+std::size_t NumaMemory::policy_node() {
+    switch (policy_) {
+        case NumaPolicy::INTERLEAVE:
+            return interleave_next_++ % nodes_.size();
+        case NumaPolicy::PREFERRED:
+            return preferred_node_;
+        case NumaPolicy::LOCAL:
+        case NumaPolicy::FIRST_TOUCH:
+            break;
+    }
+    return cpu_node_;
+}
+
+AllocId NumaMemory::node_malloc(std::size_t node, std::size_t size, std::size_t alignment) {
+    if (alignment > 1) {
+        return (engine_ == NumaEngine::BUDDY) ? nodes_[node].buddy.malloc_aligned(size, alignment)
+                                              : nodes_[node].phys.malloc_aligned(size, alignment);
+    }
+    return (engine_ == NumaEngine::BUDDY) ? nodes_[node].buddy.malloc(size)
+                                          : nodes_[node].phys.malloc(size);
+}
+
+bool NumaMemory::node_free(std::size_t node, AllocId id) {
+    return (engine_ == NumaEngine::BUDDY) ? nodes_[node].buddy.free_block(id)
+                                          : nodes_[node].phys.free_block(id);
+}
+
+
+//Allocation
+AllocId NumaMemory::malloc(std::size_t size) {
+    if (nodes_.empty())
+        return INVALID_ID;
+
+    for (std::size_t node : placement_order(policy_node())) {
+        AllocId inner = node_malloc(node, size);
+        if (inner != INVALID_ID) {
+            nodes_[node].allocations++;
+            return ids_.insert({node, inner});
+        }
+    }
+    return INVALID_ID;
+}
+
+AllocId NumaMemory::malloc_aligned(std::size_t size, std::size_t alignment) {
+    if (nodes_.empty())
+        return INVALID_ID;
+
+    for (std::size_t node : placement_order(policy_node())) {
+        AllocId inner = node_malloc(node, size, alignment);
+        if (inner != INVALID_ID) {
+            nodes_[node].allocations++;
+            return ids_.insert({node, inner});
+        }
+    }
+    return INVALID_ID;
+}
+
+bool NumaMemory::realloc(AllocId id, std::size_t size) {
+    auto *entry = ids_.find(id);
+    if (!entry)
+        return false;
+    Node &node = nodes_[entry->first];
+    return (engine_ == NumaEngine::BUDDY) ? node.buddy.realloc(entry->second, size)
+                                          : node.phys.realloc(entry->second, size);
+}
+
+AllocId NumaMemory::malloc_page(std::size_t vpage, std::size_t size) {
+    if (nodes_.empty())
+        return INVALID_ID;
+
+    std::size_t wanted = place_page(vpage);
+    for (std::size_t node : placement_order(wanted)) {
+        //page aligned like the frames of the other allocators
+        AllocId inner = node_malloc(node, size, size);
+        if (inner == INVALID_ID)
+            continue;
+
+        //record where the page really landed
+        if (node != wanted) {
+            nodes_[wanted].pages--;
+            nodes_[node].pages++;
+            page_nodes_[vpage] = node;
+        }
+        nodes_[node].allocations++;
+        return ids_.insert({node, inner});
+    }
+    return INVALID_ID;
+}
+
+bool NumaMemory::free_block(AllocId id) {
+    auto *entry = ids_.find(id);
+    if (!entry || !node_free(entry->first, entry->second))
+        return false;
+    ids_.erase(id);
+    return true;
+}
+
+bool NumaMemory::address_of(AllocId id, std::size_t &address) const {
+    auto *entry = ids_.find(id);
+    if (!entry)
+        return false;
+
+    std::size_t local = 0;
+    const Node &node = nodes_[entry->first];
+    bool ok = (engine_ == NumaEngine::BUDDY) ? node.buddy.address_of(entry->second, local)
+                                             : node.phys.address_of(entry->second, local);
+    if (!ok)
+        return false;
+    address = entry->first * node_size_ + local;
+    return true;
+}
+
+
+//Address to node mapping
+std::size_t NumaMemory::node_of(std::size_t paddr) const {
+    if (nodes_.empty())
+        return 0;
+    std::size_t node = paddr / node_size_;
+    return (node < nodes_.size()) ? node : nodes_.size() - 1;
+}
+
+std::size_t NumaMemory::place_page(std::size_t vpage) {
+    std::size_t node;
+    auto it = page_nodes_.find(vpage);
+
+    if (policy_ == NumaPolicy::FIRST_TOUCH && it != page_nodes_.end())
+        node = it->second;
+    else
+        node = policy_node();
+
+    page_nodes_[vpage] = node;
+    nodes_[node].pages++;
+    return node;
+}
+
+std::size_t NumaMemory::page_node(std::size_t vpage) const {
+    auto it = page_nodes_.find(vpage);
+    return (it != page_nodes_.end()) ? it->second : cpu_node_;
+}
+
+
+//Access cost
+std::size_t NumaMemory::charge_access(std::size_t node) {
+    std::size_t latency;
+    if (node == cpu_node_) {
+        nodes_[cpu_node_].local_accesses++;
+        latency = local_latency_;
+    } else {
+        nodes_[cpu_node_].remote_accesses++;
+        latency = remote_latency_;
+    }
+    total_latency_ += latency;
+    return latency;
+}
+
+
+//Output
+void NumaMemory::dump() const {
+    for (std::size_t i = 0; i < nodes_.size(); i++) {
+        std::cout << "Node " << i << " (base " << i * node_size_ << ", node-local ids):\n";
+        if (engine_ == NumaEngine::BUDDY)
+            nodes_[i].buddy.dump();
+        else
+            nodes_[i].phys.dump();
+    }
+}
+
+double NumaMemory::utilization() const {
+    if (nodes_.empty())
+        return 0.0;
+    double sum = 0.0;
+    for (const auto &node : nodes_)
+        sum += (engine_ == NumaEngine::BUDDY) ? node.buddy.utilization() : node.phys.utilization();
+    return sum / nodes_.size();
+}
+
+double NumaMemory::external_fragmentation() const {
+    if (nodes_.empty())
+        return 0.0;
+    double sum = 0.0;
+    for (const auto &node : nodes_) {
+        sum += (engine_ == NumaEngine::BUDDY) ? node.buddy.external_fragmentation()
+                                              : node.phys.external_fragmentation();
+    }
+    return sum / nodes_.size();
+}
+
+std::size_t NumaMemory::alloc_requests() const {
+    std::size_t total = 0;
+    for (const auto &node : nodes_)
+        total += (engine_ == NumaEngine::BUDDY) ? node.buddy.alloc_requests() : node.phys.alloc_requests();
+    return total;
+}
+
+std::size_t NumaMemory::failed_allocs() const {
+    std::size_t total = 0;
+    for (const auto &node : nodes_)
+        total += (engine_ == NumaEngine::BUDDY) ? node.buddy.failed_allocs() : node.phys.failed_allocs();
+    return total;
+}
+
+void NumaMemory::stats() const {
+    if (nodes_.empty()) {
+        std::cout << "NUMA memory not initialized\n";
+        return;
+    }
+
+    const char *policies[] = {"local", "interleave", "preferred", "first_touch"};
+    std::size_t local = 0, remote = 0;
+
+    std::cout << "NUMA Stats\n";
+    std::cout << "Nodes: " << nodes_.size() << " x " << node_size_ << " bytes\n";
+    std::cout << "Policy: " << policies[static_cast<int>(policy_)] << "\n";
+    std::cout << "CPU node: " << cpu_node_ << "\n";
+
+    for (std::size_t i = 0; i < nodes_.size(); i++) {
+        const Node &node = nodes_[i];
+        double utilization = (engine_ == NumaEngine::BUDDY) ? node.buddy.utilization()
+                                                            : node.phys.utilization();
+        std::cout << "Node " << i << ": utilization " << utilization * 100 << "%"
+                  << ", allocations " << node.allocations
+                  << ", page-ins " << node.pages
+                  << ", local accesses " << node.local_accesses
+                  << ", remote accesses " << node.remote_accesses << "\n";
+        local += node.local_accesses;
+        remote += node.remote_accesses;
+    }
+
+    std::size_t total = local + remote;
+    std::cout << "Local/remote accesses: " << local << "/" << remote << "\n";
+    std::cout << "Local access ratio: "
+              << (total ? 100.0 * local / total : 0.0) << "%\n";
+    std::cout << "Average memory latency: "
+              << (total ? (double)total_latency_ / total : 0.0) << "\n";
+}
+
+
+//Checkpoint
+void NumaMemory::save(CheckpointWriter &out) const {
+    out.begin_section(CheckpointSection::NUMA);
+    out.put(static_cast<std::uint64_t>(nodes_.size()));
+    out.put(node_size_);
+    out.put(policy_);
+    out.put(engine_);
+    out.put(allocator_);
+    out.put(preferred_node_);
+    out.put(cpu_node_);
+    out.put(interleave_next_);
+    out.put(local_latency_);
+    out.put(remote_latency_);
+    out.put(total_latency_);
+
+    for (const auto &node : nodes_) {
+        out.put(node.allocations);
+        out.put(node.pages);
+        out.put(node.local_accesses);
+        out.put(node.remote_accesses);
+        node.phys.save(out);
+        node.buddy.save(out);
+    }
+
+    ids_.save(out, [](CheckpointWriter &w, const std::pair<std::size_t, AllocId> &entry) {
+        w.put(entry.first);
+        w.put(entry.second);
+    });
+
+    out.put(static_cast<std::uint64_t>(page_nodes_.size()));
+    for (const auto &p : page_nodes_) {
+        out.put(p.first);
+        out.put(p.second);
+    }
+}
+
+bool NumaMemory::load(CheckpointReader &in) {
+    if (!in.expect_section(CheckpointSection::NUMA))
+        return false;
+
+    std::uint64_t count = 0;
+    in.get(count);
+    in.get(node_size_);
+    in.get(policy_);
+    in.get(engine_);
+    in.get(allocator_);
+    in.get(preferred_node_);
+    in.get(cpu_node_);
+    in.get(interleave_next_);
+    in.get(local_latency_);
+    in.get(remote_latency_);
+    in.get(total_latency_);
+    if (!in.ok() || count == 0 || cpu_node_ >= count || preferred_node_ >= count)
+        return false;
+
+    nodes_.clear();
+    nodes_.resize(count);
+    for (auto &node : nodes_) {
+        in.get(node.allocations);
+        in.get(node.pages);
+        in.get(node.local_accesses);
+        in.get(node.remote_accesses);
+        if (!node.phys.load(in) || !node.buddy.load(in))
+            return false;
+    }
+
+    bool ok = ids_.load(in, [count](CheckpointReader &r, std::pair<std::size_t, AllocId> &entry) {
+        return r.get(entry.first) && r.get(entry.second) && entry.first < count;
+    });
+    if (!ok)
+        return false;
+
+    std::uint64_t pages = 0;
+    if (!in.get(pages))
+        return false;
+    page_nodes_.clear();
+    for (std::uint64_t i = 0; i < pages; i++) {
+        std::size_t vpage = 0, node = 0;
+        if (!in.get(vpage) || !in.get(node) || node >= count)
+            return false;
+        page_nodes_[vpage] = node;
+    }
+    return true;
+}
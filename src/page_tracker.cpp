@@ -0,0 +1,348 @@
+#include "page_tracker.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+namespace {
+constexpr std::uint32_t NEVER = 0xffffffffu;
+constexpr std::size_t AGE_BUCKETS = 33;
+}
+
+
+PageTracker::PageTracker()
+    : enabled_(false),
+      mode_(TrackMode::EXACT),
+      window_(0),
+      scan_interval_(0),
+      countdown_(0),
+      references_(0),
+      scans_(0),
+      ring_pos_(0),
+      ring_fill_(0),
+      distinct_(0),
+      wss_current_(0),
+      wss_max_(0),
+      wss_sum_(0),
+      wss_pos_(0) {}
+
+
+bool PageTracker::start(TrackMode mode, std::size_t pages, std::size_t window, std::size_t scan_interval) {
+    if (pages == 0 || window == 0 || scan_interval == 0 || scan_interval > window)
+        return false;
+
+    enabled_ = true;
+    mode_ = mode;
+    window_ = window;
+    scan_interval_ = scan_interval;
+    accessed_.assign(pages, 0);
+    heat_.assign(pages, 0);
+    age_.assign(pages, NEVER);
+    if (mode == TrackMode::EXACT) {
+        ring_.assign(window, 0);
+        window_count_.assign(pages, 0);
+    } else {
+        ring_.clear();
+        window_count_.clear();
+    }
+    clear();
+    return true;
+}
+
+void PageTracker::stop() {
+    enabled_ = false;
+    accessed_.clear();
+    heat_.clear();
+    age_.clear();
+    ring_.clear();
+    window_count_.clear();
+    wss_history_.clear();
+}
+
+void PageTracker::clear() {
+    std::fill(accessed_.begin(), accessed_.end(), 0);
+    std::fill(heat_.begin(), heat_.end(), 0);
+    std::fill(age_.begin(), age_.end(), NEVER);
+    std::fill(window_count_.begin(), window_count_.end(), 0);
+    ring_pos_ = ring_fill_ = 0;
+    distinct_ = 0;
+    countdown_ = scan_interval_;
+    references_ = 0;
+    scans_ = 0;
+    wss_current_ = wss_max_ = 0;
+    wss_sum_ = 0;
+    wss_history_.clear();
+    wss_pos_ = 0;
+}
+
+
+//Tracking
+void PageTracker::exact_reference(std::size_t page) {
+    heat_[page]++;
+    references_++;
+
+    //slide the window: the oldest reference leaves once it is full
+    if (ring_fill_ == window_) {
+        std::size_t old = ring_[ring_pos_];
+        if (--window_count_[old] == 0)
+            distinct_--;
+    } else {
+        ring_fill_++;
+    }
+    ring_[ring_pos_] = page;
+    ring_pos_ = (ring_pos_ + 1 == window_) ? 0 : ring_pos_ + 1;
+    if (window_count_[page]++ == 0)
+        distinct_++;
+}
+
+void PageTracker::scan() {
+    countdown_ = scan_interval_;
+    scans_++;
+    if (mode_ == TrackMode::SAMPLED)
+        references_ += scan_interval_;
+
+    //pages accessed within this many scans are in the sampled working set
+    std::size_t window_scans = (window_ + scan_interval_ - 1) / scan_interval_;
+    std::uint32_t wss = 0;
+    for (std::size_t p = 0; p < accessed_.size(); p++) {
+        if (accessed_[p]) {
+            accessed_[p] = 0;
+            age_[p] = 0;
+            if (mode_ == TrackMode::SAMPLED)
+                heat_[p]++;
+        } else if (age_[p] != NEVER && age_[p] < NEVER - 1) {
+            age_[p]++;
+        }
+        if (age_[p] < window_scans)
+            wss++;
+    }
+    record_wss(mode_ == TrackMode::EXACT ? static_cast<std::uint32_t>(distinct_) : wss);
+}
+
+void PageTracker::record_wss(std::uint32_t wss) {
+    wss_current_ = wss;
+    wss_max_ = std::max(wss_max_, wss);
+    wss_sum_ += wss;
+    if (wss_history_.size() < WSS_HISTORY) {
+        wss_history_.push_back(wss);
+    } else {
+        wss_history_[wss_pos_] = wss;
+        wss_pos_ = (wss_pos_ + 1 == WSS_HISTORY) ? 0 : wss_pos_ + 1;
+    }
+}
+
+std::size_t PageTracker::age_bucket(std::uint32_t age) {
+    std::size_t bucket = 0;
+    while (age > 0) {
+        age >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+
+//Output
+void PageTracker::stats(std::size_t page_size) const {
+    if (!enabled_) {
+        std::cout << "Working set tracking is off\n";
+        return;
+    }
+
+    std::cout << "Working set tracking: " << (mode_ == TrackMode::EXACT ? "exact" : "sampled (accessed bits)")
+              << ", window " << window_ << " references, scan every " << scan_interval_ << "\n";
+    std::cout << "References: " << (mode_ == TrackMode::EXACT ? references_ : references_ + scan_interval_ - countdown_)
+              << ", scans: " << scans_ << "\n";
+
+    std::size_t touched = 0;
+    for (std::size_t p = 0; p < age_.size(); p++)
+        touched += (age_[p] != NEVER || accessed_[p]);
+    std::cout << "Pages touched: " << touched << " of " << age_.size() << "\n";
+
+    if (scans_ > 0) {
+        double average = static_cast<double>(wss_sum_) / scans_;
+        std::cout << "WSS (pages): current " << wss_current_ << ", average " << average << ", max " << wss_max_ << "\n";
+        std::cout << "WSS (bytes): current " << wss_current_ * page_size << ", max " << wss_max_ * page_size << "\n";
+    }
+
+    //idle page ages, the cold pages are the ones a smaller container gives up
+    std::vector<std::size_t> buckets(AGE_BUCKETS, 0);
+    for (std::uint32_t age : age_) {
+        if (age != NEVER)
+            buckets[age_bucket(age)]++;
+    }
+    std::cout << "Idle page ages (scans since last access):\n";
+    for (std::size_t b = 0; b < buckets.size(); b++) {
+        if (buckets[b] == 0)
+            continue;
+        std::size_t low = (b == 0) ? 0 : (std::size_t(1) << (b - 1));
+        std::size_t high = (b == 0) ? 0 : (std::size_t(1) << b) - 1;
+        std::cout << "  " << low;
+        if (high != low)
+            std::cout << "-" << high;
+        std::cout << ": " << buckets[b] << " pages\n";
+    }
+}
+
+void PageTracker::heatmap(std::size_t columns) const {
+    if (!enabled_) {
+        std::cout << "Working set tracking is off\n";
+        return;
+    }
+
+    //at most 32 rows: several pages fold into one cell when there are many
+    const char shades[] = " .:-=+*#%@";
+    std::size_t pages = heat_.size();
+    std::size_t cells = std::min<std::size_t>(pages, columns * 32);
+    std::size_t per_cell = (pages + cells - 1) / cells;
+    cells = (pages + per_cell - 1) / per_cell;
+
+    std::vector<std::uint64_t> cell_heat(cells, 0);
+    std::uint64_t peak = 0;
+    for (std::size_t p = 0; p < pages; p++) {
+        cell_heat[p / per_cell] += heat_[p];
+        peak = std::max(peak, cell_heat[p / per_cell]);
+    }
+
+    std::cout << "Page heatmap (" << per_cell << " page" << (per_cell > 1 ? "s" : "") << " per cell, max "
+              << peak << (mode_ == TrackMode::EXACT ? " references" : " accessed scans") << ")\n";
+    for (std::size_t row = 0; row * columns < cells; row++) {
+        std::cout << "page " << row * columns * per_cell << "\t|";
+        for (std::size_t c = row * columns; c < std::min(cells, (row + 1) * columns); c++) {
+            std::size_t shade = peak ? (cell_heat[c] * 9 + peak - 1) / peak : 0;
+            std::cout << shades[shade];
+        }
+        std::cout << "|\n";
+    }
+}
+
+bool PageTracker::export_csv(const std::string &prefix) const {
+    if (!enabled_)
+        return false;
+
+    std::FILE *wss = std::fopen((prefix + "_wss.csv").c_str(), "w");
+    if (!wss)
+        return false;
+    std::fprintf(wss, "scan,references,wss_pages\n");
+    //oldest kept scan first
+    std::uint64_t first = scans_ - wss_history_.size() + 1;
+    for (std::size_t i = 0; i < wss_history_.size(); i++) {
+        std::uint64_t scan = first + i;
+        std::fprintf(wss, "%llu,%llu,%u\n", static_cast<unsigned long long>(scan),
+                     static_cast<unsigned long long>(scan * scan_interval_),
+                     wss_history_[(wss_pos_ + i) % wss_history_.size()]);
+    }
+    bool ok = std::fclose(wss) == 0;
+
+    std::FILE *heat = std::fopen((prefix + "_heat.csv").c_str(), "w");
+    if (!heat)
+        return false;
+    std::fprintf(heat, "page,heat,idle_scans\n");
+    for (std::size_t p = 0; p < heat_.size(); p++) {
+        //pages touched since the last scan have not been aged yet
+        if (age_[p] == NEVER && !accessed_[p])
+            continue;
+        std::fprintf(heat, "%zu,%llu,%u\n", p, static_cast<unsigned long long>(heat_[p]),
+                     accessed_[p] ? 0u : age_[p]);
+    }
+    ok = (std::fclose(heat) == 0) && ok;
+
+    std::FILE *idle = std::fopen((prefix + "_idle.csv").c_str(), "w");
+    if (!idle)
+        return false;
+    std::vector<std::size_t> buckets(AGE_BUCKETS, 0);
+    for (std::uint32_t age : age_) {
+        if (age != NEVER)
+            buckets[age_bucket(age)]++;
+    }
+    std::fprintf(idle, "min_idle_scans,max_idle_scans,pages\n");
+    for (std::size_t b = 0; b < buckets.size(); b++) {
+        std::size_t low = (b == 0) ? 0 : (std::size_t(1) << (b - 1));
+        std::size_t high = (b == 0) ? 0 : (std::size_t(1) << b) - 1;
+        std::fprintf(idle, "%zu,%zu,%zu\n", low, high, buckets[b]);
+    }
+    ok = (std::fclose(idle) == 0) && ok;
+    return ok;
+}
+
+
+//Checkpoint
+void PageTracker::save(CheckpointWriter &out) const {
+    out.put(static_cast<std::uint8_t>(enabled_));
+    if (!enabled_)
+        return;
+    out.put(static_cast<std::uint8_t>(mode_));
+    out.put(static_cast<std::uint64_t>(accessed_.size()));
+    out.put(window_);
+    out.put(scan_interval_);
+    out.put(countdown_);
+    out.put(references_);
+    out.put(scans_);
+    out.put_bytes(accessed_.data(), accessed_.size());
+    out.put_bytes(heat_.data(), heat_.size() * sizeof(std::uint64_t));
+    out.put_bytes(age_.data(), age_.size() * sizeof(std::uint32_t));
+    if (mode_ == TrackMode::EXACT) {
+        out.put(ring_pos_);
+        out.put(ring_fill_);
+        out.put_bytes(ring_.data(), ring_.size() * sizeof(std::size_t));
+    }
+    out.put(wss_current_);
+    out.put(wss_max_);
+    out.put(wss_sum_);
+    //the ring oldest first, so loading needs no position
+    std::vector<std::uint32_t> history(wss_history_.begin() + wss_pos_, wss_history_.end());
+    history.insert(history.end(), wss_history_.begin(), wss_history_.begin() + wss_pos_);
+    out.put(static_cast<std::uint64_t>(history.size()));
+    out.put_bytes(history.data(), history.size() * sizeof(std::uint32_t));
+}
+
+bool PageTracker::load(CheckpointReader &in) {
+    std::uint8_t enabled = 0;
+    if (!in.get(enabled))
+        return false;
+    if (!enabled) {
+        stop();
+        return true;
+    }
+
+    std::uint8_t mode = 0;
+    std::uint64_t pages = 0, series = 0;
+    std::size_t window = 0, scan_interval = 0;
+    if (!in.get(mode) || mode > static_cast<std::uint8_t>(TrackMode::SAMPLED))
+        return false;
+    in.get(pages);
+    in.get(window);
+    if (!in.get(scan_interval) || !start(static_cast<TrackMode>(mode), pages, window, scan_interval))
+        return false;
+
+    in.get(countdown_);
+    in.get(references_);
+    in.get(scans_);
+    if (countdown_ == 0 || countdown_ > scan_interval_ ||
+        !in.get_bytes(accessed_.data(), accessed_.size()) ||
+        !in.get_bytes(heat_.data(), heat_.size() * sizeof(std::uint64_t)) ||
+        !in.get_bytes(age_.data(), age_.size() * sizeof(std::uint32_t)))
+        return false;
+
+    if (mode_ == TrackMode::EXACT) {
+        in.get(ring_pos_);
+        in.get(ring_fill_);
+        if (ring_pos_ >= window_ || ring_fill_ > window_ ||
+            !in.get_bytes(ring_.data(), ring_.size() * sizeof(std::size_t)))
+            return false;
+        //window counts follow from the ring
+        for (std::size_t i = 0; i < ring_fill_; i++) {
+            if (ring_[i] >= pages)
+                return false;
+            if (window_count_[ring_[i]]++ == 0)
+                distinct_++;
+        }
+    }
+
+    in.get(wss_current_);
+    in.get(wss_max_);
+    in.get(wss_sum_);
+    if (!in.get(series) || series > WSS_HISTORY || series > scans_)
+        return false;
+    wss_history_.resize(series);
+    wss_pos_ = 0;
+    return in.get_bytes(wss_history_.data(), wss_history_.size() * sizeof(std::uint32_t));
+}
@@ -0,0 +1,206 @@
+#include "perf_counters.h"
+#include <chrono>
+#include <iostream>
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char *const COMPONENT_NAMES[] = {
+    "Cache::access",
+    "VirtualMemory::access",
+    "PhysicalMemory::malloc",
+    "PhysicalMemory::free",
+    "BuddyAllocator::malloc",
+    "BuddyAllocator::free",
+};
+
+constexpr std::size_t NUM_COMPONENTS = static_cast<std::size_t>(PerfComponent::COUNT);
+constexpr int NUM_COUNTERS = 4;
+
+//Accumulated totals per component
+struct PerfTotals {
+    std::uint64_t ops;
+    PerfSample sum;
+};
+
+PerfTotals totals[NUM_COMPONENTS];
+
+#ifdef __linux__
+//One hardware counter: event fd plus its user page for rdpmc
+struct Counter {
+    int fd = -1;
+    perf_event_mmap_page *page = nullptr;
+};
+
+class CounterSet {
+public:
+    CounterSet() {
+        const std::uint64_t configs[NUM_COUNTERS] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES,
+        };
+
+        available_ = true;
+        for (int i = 0; i < NUM_COUNTERS; i++) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            if (fd < 0) {
+                available_ = false;
+                break;
+            }
+            counters_[i].fd = fd;
+
+            void *p = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, fd, 0);
+            if (p != MAP_FAILED)
+                counters_[i].page = static_cast<perf_event_mmap_page *>(p);
+        }
+        if (!available_)
+            close_all();
+    }
+
+    ~CounterSet() { close_all(); }
+
+    bool available() const { return available_; }
+
+    std::uint64_t read(int i) const {
+        const Counter &c = counters_[i];
+#if defined(__x86_64__) || defined(__i386__)
+        if (c.page && c.page->cap_user_rdpmc) {
+            //seqlock protocol from linux/perf_event.h
+            std::uint32_t seq, idx;
+            std::uint64_t count;
+            do {
+                seq = c.page->lock;
+                __atomic_signal_fence(__ATOMIC_SEQ_CST);
+                idx = c.page->index;
+                count = c.page->offset;
+                if (idx) {
+                    std::uint32_t lo, hi;
+                    __asm__ volatile("rdpmc" : "=a"(lo), "=d"(hi) : "c"(idx - 1));
+                    std::int64_t pmc = (static_cast<std::uint64_t>(hi) << 32) | lo;
+                    int shift = 64 - c.page->pmc_width;
+                    pmc = (pmc << shift) >> shift;
+                    count += pmc;
+                }
+                __atomic_signal_fence(__ATOMIC_SEQ_CST);
+            } while (c.page->lock != seq);
+            if (idx)
+                return count;
+        }
+#endif
+        std::uint64_t value = 0;
+        if (::read(c.fd, &value, sizeof(value)) != sizeof(value))
+            return 0;
+        return value;
+    }
+
+private:
+    void close_all() {
+        for (auto &c : counters_) {
+            if (c.page)
+                munmap(c.page, sysconf(_SC_PAGESIZE));
+            if (c.fd >= 0)
+                ::close(c.fd);
+            c = Counter();
+        }
+    }
+
+    Counter counters_[NUM_COUNTERS];
+    bool available_;
+};
+
+const CounterSet &counters() {
+    static CounterSet set;
+    return set;
+}
+#endif
+
+PerfSample sample_now() {
+    PerfSample s{0, 0, 0, 0, 0};
+    s.ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+#ifdef __linux__
+    const CounterSet &set = counters();
+    if (set.available()) {
+        s.cycles = set.read(0);
+        s.instructions = set.read(1);
+        s.llc_misses = set.read(2);
+        s.branch_misses = set.read(3);
+    }
+#endif
+    return s;
+}
+
+bool hardware_counters_available() {
+#ifdef __linux__
+    return counters().available();
+#else
+    return false;
+#endif
+}
+
+}
+
+
+PerfScope::PerfScope(PerfComponent component)
+    : component_(component),
+      start_(sample_now()) {}
+
+PerfScope::~PerfScope() {
+    PerfSample end = sample_now();
+    PerfTotals &t = totals[static_cast<std::size_t>(component_)];
+    t.ops++;
+    t.sum.ns += end.ns - start_.ns;
+    t.sum.cycles += end.cycles - start_.cycles;
+    t.sum.instructions += end.instructions - start_.instructions;
+    t.sum.llc_misses += end.llc_misses - start_.llc_misses;
+    t.sum.branch_misses += end.branch_misses - start_.branch_misses;
+}
+
+
+void perf_report() {
+    if (!PERF_INSTRUMENTED) {
+        std::cout << "Perf instrumentation not compiled in (build with make PERF=1)\n";
+        return;
+    }
+
+    bool hw = hardware_counters_available();
+    std::cout << "Simulator Perf Report";
+    if (!hw)
+        std::cout << " (perf_event unavailable, wall time only)";
+    std::cout << "\n";
+
+    for (std::size_t i = 0; i < NUM_COMPONENTS; i++) {
+        const PerfTotals &t = totals[i];
+        if (t.ops == 0)
+            continue;
+
+        std::cout << COMPONENT_NAMES[i] << ": ops=" << t.ops
+                  << " ns/op=" << (double)t.sum.ns / t.ops;
+        if (hw) {
+            double ipc = t.sum.cycles ? (double)t.sum.instructions / t.sum.cycles : 0.0;
+            std::cout << " IPC=" << ipc
+                      << " cycles/op=" << (double)t.sum.cycles / t.ops
+                      << " LLC-misses/op=" << (double)t.sum.llc_misses / t.ops
+                      << " branch-misses/op=" << (double)t.sum.branch_misses / t.ops;
+        }
+        std::cout << "\n";
+    }
+}
@@ -1,16 +1,32 @@
 #include "physical_memory.h"
+#include "perf_counters.h"
 #include <iostream>
 #include <algorithm>
+#include <cstdint>
+#include <map>
 
 PhysicalMemory::PhysicalMemory()
     : used_memory_(0),
       total_alloc_requests_(0),
       successful_allocs_(0),
       failed_allocs_(0),
+      invalid_frees_(0),
       total_size_(0),
       blocks_(),
-      next_id_(1),
-      allocator_(AllocatorType::FIRST_FIT) {}
+      ids_(),
+      allocator_(AllocatorType::FIRST_FIT),
+      compaction_(CompactionPolicy::OFF),
+      compaction_threshold_(0.5),
+      compactions_(0),
+      bytes_moved_(0),
+      blocks_moved_(0),
+      rescued_allocs_(0),
+      aligned_allocs_(0),
+      reallocs_(0),
+      reallocs_in_place_(0),
+      realloc_bytes_copied_(0),
+      batches_(0),
+      batched_requests_(0) {}
 
 
 void PhysicalMemory::init(std::size_t total_size) {
@@ -21,10 +37,21 @@ void PhysicalMemory::init(std::size_t total_size) {
     total_alloc_requests_ = 0;
     successful_allocs_ = 0;
     failed_allocs_ = 0;
-    next_id_ = 1;
+    invalid_frees_ = 0;
+    ids_.clear();
     allocator_ = AllocatorType::FIRST_FIT;
-
-    blocks_.emplace_back(0, total_size, true, -1);
+    compactions_ = 0;
+    bytes_moved_ = 0;
+    blocks_moved_ = 0;
+    rescued_allocs_ = 0;
+    aligned_allocs_ = 0;
+    reallocs_ = 0;
+    reallocs_in_place_ = 0;
+    realloc_bytes_copied_ = 0;
+    batches_ = 0;
+    batched_requests_ = 0;
+
+    blocks_.emplace_back(0, total_size, true, INVALID_ID);
 }
 
 void PhysicalMemory::dump() const {
@@ -39,23 +66,39 @@ void PhysicalMemory::dump() const {
     }
 }
 
-int PhysicalMemory::malloc(std::size_t size) {
+AllocId PhysicalMemory::malloc(std::size_t size) {
+    PERF_SCOPE(PHYS_MALLOC);
+    return allocate_request(size, 1);
+}
+
+AllocId PhysicalMemory::malloc_aligned(std::size_t size, std::size_t alignment) {
+    PERF_SCOPE(PHYS_MALLOC);
+    if (size == 0 || alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        total_alloc_requests_++;
+        failed_allocs_++;
+        return INVALID_ID;
+    }
+    AllocId id = allocate_request(size, alignment);
+    if (id != INVALID_ID)
+        aligned_allocs_++;
+    return id;
+}
+
+AllocId PhysicalMemory::allocate_request(std::size_t size, std::size_t alignment) {
     total_alloc_requests_++;
 
-    int id = -1;
-    switch (allocator_) {
-        case AllocatorType::FIRST_FIT:
-            id = malloc_first_fit(size);
-            break;
-        case AllocatorType::BEST_FIT:
-            id = malloc_best_fit(size);
-            break;
-        case AllocatorType::WORST_FIT:
-            id = malloc_worst_fit(size);
-            break;
+    AllocId id = allocate_with_strategy(size, alignment);
+
+    //enough memory is free but no single hole fits: compact and retry
+    if (id == INVALID_ID && compaction_ != CompactionPolicy::OFF &&
+        total_size_ - used_memory_ >= size) {
+        compact();
+        id = allocate_with_strategy(size, alignment);
+        if (id != INVALID_ID)
+            rescued_allocs_++;
     }
 
-    if (id == -1)
+    if (id == INVALID_ID)
         failed_allocs_++;
     else
         successful_allocs_++;
@@ -63,117 +106,406 @@ int PhysicalMemory::malloc(std::size_t size) {
     return id;
 }
 
+AllocId PhysicalMemory::allocate_with_strategy(std::size_t size, std::size_t alignment) {
+    auto hole = find_hole(size, alignment);
+    return (hole != blocks_.end()) ? allocate_from_block(hole, size, alignment) : INVALID_ID;
+}
+
+std::list<Block>::iterator PhysicalMemory::find_hole(std::size_t size, std::size_t alignment) {
+    switch (allocator_) {
+        case AllocatorType::FIRST_FIT:
+            return find_first_fit(size, alignment);
+        case AllocatorType::BEST_FIT:
+            return find_best_fit(size, alignment);
+        case AllocatorType::WORST_FIT:
+            return find_worst_fit(size, alignment);
+    }
+    return blocks_.end();
+}
+
+std::size_t PhysicalMemory::fit_padding(const Block &blk, std::size_t size, std::size_t alignment) {
+    if (!blk.free)
+        return SIZE_MAX;
+    std::size_t padding = (alignment - blk.start % alignment) % alignment;
+    return (blk.size >= padding && blk.size - padding >= size) ? padding : SIZE_MAX;
+}
+
 void PhysicalMemory::set_allocator(AllocatorType type) {
     allocator_ = type;
 }
 
-int PhysicalMemory::malloc_first_fit(std::size_t size) {
+void PhysicalMemory::set_compaction(CompactionPolicy policy, double threshold) {
+    compaction_ = policy;
+    compaction_threshold_ = threshold;
+}
+
+//Compaction
+//Used blocks keep their order and ids, only their start address changes.
+//Aligned blocks slide only down to their alignment, the padding in front
+//stays a free hole. Every byte of a block that has to slide down is
+//charged as moved.
+std::size_t PhysicalMemory::compact() {
+    std::size_t next_start = 0;
+    std::size_t moved = 0;
+
+    for (auto it = blocks_.begin(); it != blocks_.end();) {
+        if (it->free) {
+            it = blocks_.erase(it);
+            continue;
+        }
+        std::size_t padding = (it->alignment - next_start % it->alignment) % it->alignment;
+        if (padding > 0) {
+            blocks_.insert(it, Block(next_start, padding, true, INVALID_ID));
+            next_start += padding;
+        }
+        if (it->start != next_start) {
+            moved += it->size;
+            blocks_moved_++;
+            it->start = next_start;
+        }
+        next_start += it->size;
+        ++it;
+    }
+
+    if (next_start < total_size_)
+        blocks_.emplace_back(next_start, total_size_ - next_start, true, INVALID_ID);
+
+    compactions_++;
+    bytes_moved_ += moved;
+    return moved;
+}
+
+//Holes are ranked by the bytes left after alignment padding
+std::list<Block>::iterator PhysicalMemory::find_first_fit(std::size_t size, std::size_t alignment) {
     for (auto it = blocks_.begin(); it != blocks_.end(); ++it) {
-        if (it->free && it->size >= size) {
-            return allocate_from_block(it, size);
+        if (fit_padding(*it, size, alignment) != SIZE_MAX) {
+            return it;
         }
     }
-    return -1;
+    return blocks_.end();
 }
 
-int PhysicalMemory::malloc_best_fit(std::size_t size) {
+std::list<Block>::iterator PhysicalMemory::find_best_fit(std::size_t size, std::size_t alignment) {
     auto best = blocks_.end();
+    std::size_t best_usable = 0;
 
     for (auto it = blocks_.begin(); it != blocks_.end(); ++it) {
-        if (it->free && it->size >= size) {
-            if (best == blocks_.end() || it->size < best->size)
+        std::size_t padding = fit_padding(*it, size, alignment);
+        if (padding != SIZE_MAX) {
+            if (best == blocks_.end() || it->size - padding < best_usable) {
                 best = it;
+                best_usable = it->size - padding;
+            }
         }
     }
 
-    return (best != blocks_.end()) ? allocate_from_block(best, size) : -1;
+    return best;
 }
 
-int PhysicalMemory::malloc_worst_fit(std::size_t size) {
+std::list<Block>::iterator PhysicalMemory::find_worst_fit(std::size_t size, std::size_t alignment) {
     auto worst = blocks_.end();
+    std::size_t worst_usable = 0;
 
     for (auto it = blocks_.begin(); it != blocks_.end(); ++it) {
-        if (it->free && it->size >= size) {
-            if (worst == blocks_.end() || it->size > worst->size)
+        std::size_t padding = fit_padding(*it, size, alignment);
+        if (padding != SIZE_MAX) {
+            if (worst == blocks_.end() || it->size - padding > worst_usable) {
                 worst = it;
+                worst_usable = it->size - padding;
+            }
         }
     }
 
-    return (worst != blocks_.end()) ? allocate_from_block(worst, size) : -1;
+    return worst;
 }
 
-int PhysicalMemory::allocate_from_block(std::list<Block>::iterator it, std::size_t size) {
-    int id = next_id_++;
+AllocId PhysicalMemory::allocate_from_block(std::list<Block>::iterator it, std::size_t size, std::size_t alignment) {
+    auto used_it = carve(it, size, alignment);
+    AllocId id = ids_.insert(used_it);
+    used_it->id = id;
+    return id;
+}
+
+std::list<Block>::iterator PhysicalMemory::carve(std::list<Block>::iterator it, std::size_t size, std::size_t alignment) {
+    //padding in front of an aligned start becomes its own free hole
+    std::size_t padding = (alignment - it->start % alignment) % alignment;
+    if (padding > 0) {
+        blocks_.insert(it, Block(it->start, padding, true, INVALID_ID));
+        it->start += padding;
+        it->size -= padding;
+    }
 
     // exact fit
     if (it->size == size) {
         it->free = false;
-        it->id = id;
+        it->alignment = alignment;
         used_memory_ += size; 
-        return id;
+        return it;
     }
 
     std::size_t remaining_size = it->size - size;
     std::size_t new_start = it->start + size;
 
-    Block allocated(it->start, size, false, id);
-    Block remaining(new_start, remaining_size, true, -1);
+    Block allocated(it->start, size, false, INVALID_ID, alignment);
+    Block remaining(new_start, remaining_size, true, INVALID_ID);
 
     auto next_it = blocks_.erase(it);
-    blocks_.insert(next_it, allocated);
+    auto used_it = blocks_.insert(next_it, allocated);
     blocks_.insert(next_it, remaining);
 
     used_memory_ += size;
-    return id;
+    return used_it;
+}
+
+bool PhysicalMemory::free_block(AllocId id) {
+    PERF_SCOPE(PHYS_FREE);
+    auto *slot = ids_.find(id);
+    if (!slot) {
+        //unknown, stale or double free
+        invalid_frees_++;
+        return false;
+    }
+
+    auto it = *slot;
+    ids_.erase(id);
+    release(it);
+    compact_if_fragmented();
+    return true;
+}
+
+void PhysicalMemory::release(std::list<Block>::iterator it) {
+    it->free = true;
+    it->id = INVALID_ID;
+    it->alignment = 1;
+    used_memory_ -= it->size;
+
+    if (it != blocks_.begin()) {
+        auto prev = std::prev(it);
+        if (prev->free) {
+            prev->size += it->size;
+            it = blocks_.erase(it);
+            it = prev;
+        }
+    }
+
+    auto next = std::next(it);
+    if (next != blocks_.end() && next->free) {
+        it->size += next->size;
+        blocks_.erase(next);
+    }
+}
+
+void PhysicalMemory::compact_if_fragmented() {
+    if (compaction_ == CompactionPolicy::THRESHOLD &&
+        external_fragmentation() > compaction_threshold_) {
+        compact();
+    }
 }
 
-bool PhysicalMemory::free_block(int id) {
-    for (auto it = blocks_.begin(); it != blocks_.end(); ++it) {
-        if (!it->free && it->id == id) {
-            it->free = true;
-            it->id = -1;
-            used_memory_ -= it->size;
-
-            if (it != blocks_.begin()) {
-                auto prev = std::prev(it);
-                if (prev->free) {
-                    prev->size += it->size;
-                    it = blocks_.erase(it);
-                    it = prev;
-                }
-            }
 
-            auto next = std::next(it);
+//Realloc
+//Shrinking hands the tail back (merged into a free right neighbour).
+//Growing takes the missing bytes from a free right neighbour, otherwise
+//the block moves: new block first (with the block's alignment), old
+//contents charged as copied, then the old block is released and the id
+//rebound to the new one.
+bool PhysicalMemory::realloc(AllocId id, std::size_t size) {
+    PERF_SCOPE(PHYS_MALLOC);
+    auto *slot = ids_.find(id);
+    if (!slot || size == 0)
+        return false;
+    reallocs_++;
+
+    auto it = *slot;
+    auto next = std::next(it);
+    if (size <= it->size) {
+        std::size_t tail = it->size - size;
+        if (tail > 0) {
+            it->size = size;
+            used_memory_ -= tail;
             if (next != blocks_.end() && next->free) {
-                it->size += next->size;
-                blocks_.erase(next);
+                next->start -= tail;
+                next->size += tail;
+            } else {
+                blocks_.insert(next, Block(it->start + size, tail, true, INVALID_ID));
             }
-            return true;
         }
+        reallocs_in_place_++;
+        return true;
     }
-    return false;
+
+    std::size_t missing = size - it->size;
+    if (next != blocks_.end() && next->free && next->size >= missing) {
+        it->size = size;
+        used_memory_ += missing;
+        next->start += missing;
+        next->size -= missing;
+        if (next->size == 0)
+            blocks_.erase(next);
+        reallocs_in_place_++;
+        return true;
+    }
+
+    auto hole = find_hole(size, it->alignment);
+    if (hole == blocks_.end())
+        return false;
+    auto target = carve(hole, size, it->alignment);
+    target->id = id;
+    *slot = target;
+
+    realloc_bytes_copied_ += it->size;
+    release(it);
+    compact_if_fragmented();
+    return true;
 }
 
-void PhysicalMemory::stats() const {
-    if (total_size_ == 0) {
-        std::cout << "Memory not initialized\n";
-        return;
+
+//Batches
+//First fit resumes its walk at the hole it used last as long as the sizes
+//do not shrink (every hole it skipped is still too small). Best and worst
+//fit index the free holes once per batch, ordered by (size, start), which
+//picks the same holes as the list walk of single calls.
+std::size_t PhysicalMemory::malloc_batch(const std::vector<std::size_t> &sizes, std::vector<AllocId> &ids) {
+    PERF_SCOPE(PHYS_MALLOC);
+    batches_++;
+    batched_requests_ += sizes.size();
+    ids.assign(sizes.size(), INVALID_ID);
+
+    std::map<std::pair<std::size_t, std::size_t>, std::list<Block>::iterator> holes;
+    auto cursor = blocks_.begin();
+    std::size_t last_size = 0;
+    auto restart = [&]() {
+        cursor = blocks_.begin();
+        last_size = 0;
+        holes.clear();
+        if (allocator_ == AllocatorType::FIRST_FIT)
+            return;
+        for (auto it = blocks_.begin(); it != blocks_.end(); ++it) {
+            if (it->free)
+                holes.emplace(std::make_pair(it->size, it->start), it);
+        }
+    };
+    auto take = [&](std::size_t size) -> AllocId {
+        if (allocator_ == AllocatorType::FIRST_FIT) {
+            if (size < last_size)
+                cursor = blocks_.begin();
+            last_size = size;
+            while (cursor != blocks_.end() && !(cursor->free && cursor->size >= size))
+                ++cursor;
+            if (cursor == blocks_.end())
+                return INVALID_ID;
+            AllocId id = allocate_from_block(cursor, size);
+            cursor = std::next(*ids_.find(id));
+            return id;
+        }
+
+        auto hole = holes.end();
+        if (allocator_ == AllocatorType::BEST_FIT)
+            hole = holes.lower_bound({size, 0});
+        else if (!holes.empty())
+            hole = holes.lower_bound({std::prev(holes.end())->first.first, 0});
+        if (hole == holes.end() || hole->first.first < size)
+            return INVALID_ID;
+
+        auto it = hole->second;
+        bool split = it->size > size;
+        holes.erase(hole);
+        AllocId id = allocate_from_block(it, size);
+        if (split) {
+            auto rest = std::next(*ids_.find(id));
+            holes.emplace(std::make_pair(rest->size, rest->start), rest);
+        }
+        return id;
+    };
+
+    restart();
+    std::size_t done = 0;
+    for (std::size_t i = 0; i < sizes.size(); i++) {
+        total_alloc_requests_++;
+        AllocId id = take(sizes[i]);
+        if (id == INVALID_ID && compaction_ != CompactionPolicy::OFF &&
+            total_size_ - used_memory_ >= sizes[i]) {
+            compact();
+            restart();
+            id = take(sizes[i]);
+            if (id != INVALID_ID)
+                rescued_allocs_++;
+        }
+
+        if (id == INVALID_ID) {
+            failed_allocs_++;
+        } else {
+            successful_allocs_++;
+            done++;
+        }
+        ids[i] = id;
     }
+    return done;
+}
 
-    std::size_t free_memory = total_size_ - used_memory_;
-    std::size_t largest_free = 0;
+//Frees coalesce one by one (O(1) each); the threshold compaction check,
+//a walk over all blocks, runs once per batch
+std::size_t PhysicalMemory::free_batch(const std::vector<AllocId> &ids) {
+    PERF_SCOPE(PHYS_FREE);
+    batches_++;
+    batched_requests_ += ids.size();
+
+    std::size_t done = 0;
+    for (AllocId id : ids) {
+        auto *slot = ids_.find(id);
+        if (!slot) {
+            invalid_frees_++;
+            continue;
+        }
+        auto it = *slot;
+        ids_.erase(id);
+        release(it);
+        done++;
+    }
+    compact_if_fragmented();
+    return done;
+}
 
+std::size_t PhysicalMemory::largest_free_block() const {
+    std::size_t largest_free = 0;
     for (const auto &blk : blocks_) {
         if (blk.free)
             largest_free = std::max(largest_free, blk.size);
     }
+    return largest_free;
+}
+
+double PhysicalMemory::external_fragmentation() const {
+    std::size_t free_memory = total_size_ - used_memory_;
+    std::size_t largest_free = largest_free_block();
+
+    if (free_memory > 0 && largest_free < free_memory)
+        return 1.0 - (double)largest_free / free_memory;
+    return 0.0;
+}
+
+double PhysicalMemory::utilization() const {
+    return (total_size_ == 0) ? 0.0 : (double)used_memory_ / total_size_;
+}
 
-    double external_frag = 0.0;
-    if (free_memory > 0 && largest_free < free_memory) {
-        external_frag = 1.0 - (double)largest_free / free_memory;
+bool PhysicalMemory::address_of(AllocId id, std::size_t &address) const {
+    auto *slot = ids_.find(id);
+    if (!slot)
+        return false;
+    address = (*slot)->start;
+    return true;
+}
+
+void PhysicalMemory::stats() const {
+    if (total_size_ == 0) {
+        std::cout << "Memory not initialized\n";
+        return;
     }
 
-    double utilization = (double)used_memory_ / total_size_;
+    std::size_t free_memory = total_size_ - used_memory_;
+    double external_frag = external_fragmentation();
+
+    double utilization = this->utilization();
 
     std::cout << "Total memory: " << total_size_ << "\n";
     std::cout << "Used memory: " << used_memory_ << "\n";
@@ -183,4 +515,115 @@ void PhysicalMemory::stats() const {
     std::cout << "Alloc requests: " << total_alloc_requests_ << "\n";
     std::cout << "Successful allocs: " << successful_allocs_ << "\n";
     std::cout << "Failed allocs: " << failed_allocs_ << "\n";
-}
\ No newline at end of file
+    if (invalid_frees_ > 0)
+        std::cout << "Invalid frees: " << invalid_frees_ << "\n";
+
+    if (compactions_ > 0) {
+        std::cout << "Compactions: " << compactions_ << "\n";
+        std::cout << "Blocks moved: " << blocks_moved_ << "\n";
+        std::cout << "Bytes moved: " << bytes_moved_ << "\n";
+        std::cout << "Allocs rescued by compaction: " << rescued_allocs_ << "\n";
+        if (rescued_allocs_ > 0) {
+            std::cout << "Bytes moved per rescued alloc: "
+                      << (double)bytes_moved_ / rescued_allocs_ << "\n";
+        }
+    }
+    if (aligned_allocs_ > 0)
+        std::cout << "Aligned allocs: " << aligned_allocs_ << "\n";
+    if (reallocs_ > 0) {
+        std::cout << "Reallocs: " << reallocs_ << " (in place " << reallocs_in_place_
+                  << ", bytes copied " << realloc_bytes_copied_ << ")\n";
+    }
+    if (batches_ > 0)
+        std::cout << "Batches: " << batches_ << " (" << batched_requests_ << " requests)\n";
+}
+
+//Checkpoint
+void PhysicalMemory::save(CheckpointWriter &out) const {
+    out.begin_section(CheckpointSection::PHYSICAL);
+    out.put(total_size_);
+    out.put(used_memory_);
+    out.put(total_alloc_requests_);
+    out.put(successful_allocs_);
+    out.put(failed_allocs_);
+    out.put(invalid_frees_);
+    out.put(allocator_);
+    out.put(compaction_);
+    out.put(compaction_threshold_);
+    out.put(compactions_);
+    out.put(bytes_moved_);
+    out.put(blocks_moved_);
+    out.put(rescued_allocs_);
+    out.put(aligned_allocs_);
+    out.put(reallocs_);
+    out.put(reallocs_in_place_);
+    out.put(realloc_bytes_copied_);
+    out.put(batches_);
+    out.put(batched_requests_);
+
+    out.put(static_cast<std::uint64_t>(blocks_.size()));
+    for (const auto &blk : blocks_) {
+        out.put(blk.start);
+        out.put(blk.size);
+        out.put(static_cast<std::uint8_t>(blk.free));
+        out.put(blk.id);
+        out.put(blk.alignment);
+    }
+    //iterators are rebuilt from the block list on load
+    ids_.save(out, [](CheckpointWriter &, const std::list<Block>::iterator &) {});
+}
+
+bool PhysicalMemory::load(CheckpointReader &in) {
+    if (!in.expect_section(CheckpointSection::PHYSICAL))
+        return false;
+
+    std::uint64_t count = 0;
+    in.get(total_size_);
+    in.get(used_memory_);
+    in.get(total_alloc_requests_);
+    in.get(successful_allocs_);
+    in.get(failed_allocs_);
+    in.get(invalid_frees_);
+    in.get(allocator_);
+    in.get(compaction_);
+    in.get(compaction_threshold_);
+    in.get(compactions_);
+    in.get(bytes_moved_);
+    in.get(blocks_moved_);
+    in.get(rescued_allocs_);
+    in.get(aligned_allocs_);
+    in.get(reallocs_);
+    in.get(reallocs_in_place_);
+    in.get(realloc_bytes_copied_);
+    in.get(batches_);
+    in.get(batched_requests_);
+    if (!in.get(count))
+        return false;
+
+    blocks_.clear();
+    for (std::uint64_t i = 0; i < count; i++) {
+        std::size_t start = 0, size = 0, alignment = 0;
+        std::uint8_t free = 0;
+        AllocId id = INVALID_ID;
+        if (!in.get(start) || !in.get(size) || !in.get(free) || !in.get(id) || !in.get(alignment) ||
+            alignment == 0 || (alignment & (alignment - 1)) != 0)
+            return false;
+        blocks_.emplace_back(start, size, free != 0, id, alignment);
+    }
+
+    auto skip = [](CheckpointReader &, std::list<Block>::iterator &) { return true; };
+    if (!ids_.load(in, skip))
+        return false;
+
+    std::size_t used_blocks = 0;
+    for (auto it = blocks_.begin(); it != blocks_.end(); ++it) {
+        if (it->free)
+            continue;
+        auto *slot = ids_.find(it->id);
+        if (!slot)
+            return false;
+        *slot = it;
+        used_blocks++;
+    }
+    return ids_.size() == used_blocks;
+}
@@ -0,0 +1,147 @@
+#include "sampler.h"
+#include <cmath>
+#include <iostream>
+
+namespace {
+//z value for a two sided 95% confidence interval
+constexpr double Z_95 = 1.96;
+
+//Mean and 95% half-width of per-window ratios
+struct Estimate {
+    std::uint64_t samples;
+    std::uint64_t skipped;   //windows without events
+    double mean;
+    double half_width;
+};
+
+Estimate estimate(std::uint64_t samples, std::uint64_t skipped, double sum, double sum_sq) {
+    Estimate e{samples, skipped, 0.0, 0.0};
+    if (e.samples == 0)
+        return e;
+
+    e.mean = sum / e.samples;
+    if (e.samples > 1) {
+        double var = (sum_sq - e.samples * e.mean * e.mean) / (e.samples - 1);
+        e.half_width = Z_95 * std::sqrt(var > 0.0 ? var : 0.0) / std::sqrt((double)e.samples);
+    }
+    return e;
+}
+
+void print_estimate(const char *name, const Estimate &e, std::uint64_t references) {
+    std::cout << name << ": ";
+    if (e.samples == 0) {
+        std::cout << "no samples\n";
+        return;
+    }
+    std::cout << e.mean * 100 << "% +/- " << e.half_width * 100 << "% (95% CI, "
+              << e.samples << " windows";
+    if (e.skipped > 0)
+        std::cout << ", " << e.skipped << " without events";
+    std::cout << ")";
+    if (references > 0)
+        std::cout << ", extrapolated " << (std::uint64_t)(e.mean * references)
+                  << " of " << references;
+    std::cout << "\n";
+}
+}
+
+
+Sampler::Sampler()
+    : enabled_(false),
+      functional_warming_(true),
+      fast_forward_(0),
+      warmup_(0),
+      detail_(0),
+      references_(0),
+      detailed_references_(0),
+      baseline_{0, 0, 0, 0, 0, 0},
+      windows_(0) {}
+
+
+void Sampler::RatioSum::add(std::size_t part, std::size_t other) {
+    if (part + other == 0) {
+        skipped++;
+        return;
+    }
+    double r = (double)part / (part + other);
+    sum += r;
+    sum_sq += r * r;
+    samples++;
+}
+
+
+bool Sampler::init(std::uint64_t fast_forward, std::uint64_t warmup, std::uint64_t detail,
+                   bool functional_warming) {
+    if (detail == 0) {
+        std::cout << "Detailed window length must be positive\n";
+        return false;
+    }
+
+    fast_forward_ = fast_forward;
+    warmup_ = warmup;
+    detail_ = detail;
+    functional_warming_ = functional_warming;
+    references_ = 0;
+    detailed_references_ = 0;
+    baseline_ = SampleCounters{0, 0, 0, 0, 0, 0};
+    windows_ = 0;
+    l1_hit_rate_ = RatioSum();
+    l2_hit_rate_ = RatioSum();
+    fault_rate_ = RatioSum();
+    enabled_ = true;
+    return true;
+}
+
+
+//Phase tracking
+SamplePhase Sampler::begin_reference(const SampleCounters &now) {
+    std::uint64_t offset = references_ % period();
+
+    if (offset < fast_forward_)
+        return SamplePhase::FAST_FORWARD;
+    if (offset < fast_forward_ + warmup_)
+        return SamplePhase::WARMUP;
+
+    if (offset == fast_forward_ + warmup_)
+        baseline_ = now;
+    return SamplePhase::DETAIL;
+}
+
+void Sampler::end_reference(const SampleCounters &now) {
+    std::uint64_t offset = references_ % period();
+    references_++;
+
+    if (offset < fast_forward_ + warmup_)
+        return;
+
+    detailed_references_++;
+    if (offset + 1 == period()) {
+        //only the running sums are kept, so long traces run in constant memory
+        windows_++;
+        l1_hit_rate_.add(now.l1_hits - baseline_.l1_hits, now.l1_misses - baseline_.l1_misses);
+        l2_hit_rate_.add(now.l2_hits - baseline_.l2_hits, now.l2_misses - baseline_.l2_misses);
+        fault_rate_.add(now.page_faults - baseline_.page_faults, now.page_hits - baseline_.page_hits);
+    }
+}
+
+
+//Report
+void Sampler::report() const {
+    std::cout << "Sampled Simulation\n";
+    std::cout << "Phases: fast-forward=" << fast_forward_ << " warm-up=" << warmup_
+              << " detailed=" << detail_
+              << (functional_warming_ ? " (functional warming)" : " (cold skip)") << "\n";
+    std::cout << "References: " << references_ << "\n";
+    std::cout << "Detailed references: " << detailed_references_ << " ("
+              << (references_ ? 100.0 * detailed_references_ / references_ : 0.0) << "%)\n";
+    std::cout << "Complete windows: " << windows_ << "\n";
+
+    Estimate l1 = estimate(l1_hit_rate_.samples, l1_hit_rate_.skipped, l1_hit_rate_.sum, l1_hit_rate_.sum_sq);
+    Estimate l2 = estimate(l2_hit_rate_.samples, l2_hit_rate_.skipped, l2_hit_rate_.sum, l2_hit_rate_.sum_sq);
+    Estimate faults = estimate(fault_rate_.samples, fault_rate_.skipped, fault_rate_.sum, fault_rate_.sum_sq);
+
+    //L1 and fault rates are per reference, L2 hit rate is per L1 miss
+    print_estimate("L1 hit rate", l1, references_);
+    print_estimate("L2 hit rate (of L1 misses)", l2, 0);
+    print_estimate("Page fault rate", faults, faults.samples ? references_ : 0);
+}
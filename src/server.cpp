@@ -0,0 +1,356 @@
+#include "server.h"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+volatile std::sig_atomic_t stop_requested = 0;
+
+void request_stop(int) {
+    stop_requested = 1;
+}
+
+constexpr std::size_t READ_CHUNK = 64 * 1024;
+
+//The REPL and the components write to std::cout; while a frame is
+//served that goes into text, so sessions never print on the console
+struct CaptureOutput {
+    std::ostringstream text;
+    std::streambuf *console;
+
+    CaptureOutput() : console(std::cout.rdbuf(text.rdbuf())) {}
+    ~CaptureOutput() { std::cout.rdbuf(console); }
+};
+
+template <typename T>
+void append(std::vector<char> &out, const T &value) {
+    const char *bytes = reinterpret_cast<const char *>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+}
+
+
+Server::Server()
+    : listen_fd_(-1),
+      epoll_fd_(-1),
+      frames_(0),
+      requests_(0) {}
+
+Server::~Server() {
+    for (const auto &client : clients_)
+        close(client.first);
+    if (epoll_fd_ >= 0)
+        close(epoll_fd_);
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        unlink(path_.c_str());
+    }
+}
+
+
+//Setup
+bool Server::listen(const std::string &path) {
+    sockaddr_un addr{};
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        std::cout << "Socket path must be 1 to " << sizeof(addr.sun_path) - 1 << " characters\n";
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    //only a stale socket is replaced, never a regular file
+    struct stat st{};
+    if (stat(path.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            std::cout << path << " exists and is not a socket\n";
+            return false;
+        }
+        unlink(path.c_str());
+    }
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0 || bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+        std::cout << "Cannot bind " << path << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    path_ = path;
+    if (::listen(listen_fd_, SOMAXCONN) != 0)
+        return false;
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = listen_fd_;
+    return epoll_fd_ >= 0 && epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev) == 0;
+}
+
+
+//Event loop
+void Server::run() {
+    struct sigaction sa{};
+    sa.sa_handler = request_stop;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::cout << "Listening on " << path_ << std::endl;
+
+    epoll_event events[64];
+    while (!stop_requested) {
+        int ready = epoll_wait(epoll_fd_, events, 64, -1);
+        if (ready < 0) {
+            if (errno == EINTR)
+                continue;
+            std::cout << "epoll_wait failed: " << std::strerror(errno) << "\n";
+            break;
+        }
+
+        for (int i = 0; i < ready; i++) {
+            int fd = events[i].data.fd;
+            if (fd == listen_fd_) {
+                accept_clients();
+                continue;
+            }
+            auto it = clients_.find(fd);
+            if (it == clients_.end())
+                continue;
+
+            Client &client = it->second;
+            std::uint32_t what = events[i].events;
+            bool ok = !(what & EPOLLERR);
+            if (ok && (what & (EPOLLIN | EPOLLHUP)))
+                ok = read_client(fd, client);
+            if (ok)
+                ok = pump(fd, client);
+            //a client that shut down is dropped once its replies are out
+            if (!ok || (client.closing && client.out.empty()))
+                drop_client(fd);
+            else
+                update_events(fd, client);
+        }
+    }
+
+    std::cout << "Served " << frames_ << " frames, " << requests_ << " requests, "
+              << sessions_.size() << " open sessions\n";
+}
+
+void Server::accept_clients() {
+    while (true) {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;   //EAGAIN: all pending connections taken
+
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            close(fd);
+            continue;
+        }
+        clients_[fd].events = EPOLLIN;
+    }
+}
+
+void Server::drop_client(int fd) {
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    clients_.erase(fd);
+}
+
+void Server::update_events(int fd, Client &client) {
+    std::size_t backlog = client.out.size() - client.out_sent;
+    std::uint32_t events = 0;
+    if (backlog < MAX_FRAME && !client.closing)
+        events |= EPOLLIN;
+    if (backlog > 0)
+        events |= EPOLLOUT;
+    if (events == client.events)
+        return;
+
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.fd = fd;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev);
+    client.events = events;
+}
+
+
+//I/O
+bool Server::read_client(int fd, Client &client) {
+    //one read per wakeup, epoll reports the rest again, so a flooding
+    //client cannot grow the buffer beyond a frame and a chunk
+    if (client.in.size() - client.in_used < READ_CHUNK)
+        client.in.resize(client.in_used + 2 * READ_CHUNK);
+    ssize_t got = read(fd, client.in.data() + client.in_used, client.in.size() - client.in_used);
+    if (got > 0)
+        client.in_used += got;
+    else if (got == 0)
+        client.closing = true;
+    else
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    return true;
+}
+
+bool Server::write_client(int fd, Client &client) {
+    while (client.out_sent < client.out.size()) {
+        ssize_t sent = send(fd, client.out.data() + client.out_sent, client.out.size() - client.out_sent,
+                            MSG_NOSIGNAL);
+        if (sent > 0) {
+            client.out_sent += sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            //keep the backlog from growing behind a slow reader
+            if (client.out_sent > client.out.size() / 2) {
+                client.out.erase(client.out.begin(), client.out.begin() + client.out_sent);
+                client.out_sent = 0;
+            }
+            return true;
+        }
+        return false;
+    }
+    client.out.clear();
+    client.out_sent = 0;
+    return true;
+}
+
+
+//Serving stops at a full reply backlog with frames still buffered; once a
+//write drains it those frames must run now, the client may send nothing
+//more until it has its replies
+bool Server::pump(int fd, Client &client) {
+    bool progress = true;
+    while (progress) {
+        std::size_t in_before = client.in_used;
+        if (!serve_frames(client))
+            return false;
+        std::size_t queued = client.out.size() - client.out_sent;
+        if (!write_client(fd, client))
+            return false;
+        progress = client.in_used != in_before || client.out.size() - client.out_sent < queued;
+    }
+    return true;
+}
+
+
+//Frames
+bool Server::serve_frames(Client &client) {
+    std::size_t pos = 0;
+    while (client.in_used - pos >= sizeof(FrameHeader) &&
+           client.out.size() - client.out_sent < MAX_FRAME) {
+        FrameHeader header;
+        std::memcpy(&header, client.in.data() + pos, sizeof(header));
+        if (header.bytes > MAX_FRAME)
+            return false;
+        std::size_t size = sizeof(header) + header.bytes;
+        if (client.in_used - pos < size)
+            break;   //rest of the frame still on its way
+        if (!serve_frame(client.in.data() + pos, size, client))
+            return false;
+        pos += size;
+    }
+
+    if (pos > 0) {
+        std::memmove(client.in.data(), client.in.data() + pos, client.in_used - pos);
+        client.in_used -= pos;
+    }
+    //an incomplete frame at shutdown can never finish
+    return !(client.closing && client.in_used > 0 && client.out.size() == client.out_sent);
+}
+
+Simulator &Server::session(const std::string &name) {
+    auto &sim = sessions_[name];
+    if (!sim)
+        sim.reset(new Simulator());
+    return *sim;
+}
+
+bool Server::serve_frame(const char *frame, std::size_t size, Client &client) {
+    FrameHeader header;
+    std::memcpy(&header, frame, sizeof(header));
+    const char *p = frame + sizeof(header);
+    const char *end = frame + size;
+    if (static_cast<std::size_t>(end - p) < header.name_length)
+        return false;
+    std::string name(p, header.name_length);
+    p += header.name_length;
+
+    CaptureOutput output;
+    std::size_t reply_at = client.out.size();
+    append(client.out, ReplyHeader{0, header.requests});
+
+    //consecutive trace requests run as one apply call, so BATCH works within a run
+    std::vector<TraceRecord> records;
+    std::vector<RecordResult> results;
+    auto flush = [&]() {
+        if (records.empty())
+            return;
+        session(name).apply(records, results);
+        for (const RecordResult &r : results) {
+            WireReply reply{static_cast<std::uint8_t>(r.ok ? ReplyStatus::OK : ReplyStatus::FAILED),
+                            static_cast<std::uint8_t>(r.served), 0, 0, r.value};
+            append(client.out, reply);
+        }
+        records.clear();
+    };
+
+    for (std::uint32_t i = 0; i < header.requests; i++) {
+        WireRequest request;
+        if (static_cast<std::size_t>(end - p) < sizeof(request))
+            return false;
+        std::memcpy(&request, p, sizeof(request));
+        p += sizeof(request);
+
+        if (request.op <= static_cast<std::uint8_t>(TraceOp::BATCH) &&
+            request.type <= static_cast<std::uint8_t>(AccessType::IFETCH)) {
+            TraceRecord record{static_cast<TraceOp>(request.op), request.stream, request.value,
+                               static_cast<AccessType>(request.type), request.arg};
+            records.push_back(record);
+            continue;
+        }
+
+        flush();
+        WireReply reply{static_cast<std::uint8_t>(ReplyStatus::BAD_REQUEST), 0, 0, 0, 0};
+        if (request.op != COMMAND_OP) {
+            append(client.out, reply);
+            continue;
+        }
+
+        if (static_cast<std::uint64_t>(end - p) < request.value)
+            return false;
+        std::string line(p, request.value);
+        p += request.value;
+
+        //only a command's own output goes back to the client
+        output.text.str("");
+        if (!session(name).execute(line))
+            sessions_.erase(name);
+
+        std::string text = output.text.str();
+        reply.status = static_cast<std::uint8_t>(ReplyStatus::OK);
+        reply.text_length = static_cast<std::uint32_t>(text.size());
+        append(client.out, reply);
+        client.out.insert(client.out.end(), text.begin(), text.end());
+    }
+    flush();
+    if (p != end)
+        return false;
+
+    ReplyHeader reply_header{static_cast<std::uint32_t>(client.out.size() - reply_at - sizeof(ReplyHeader)),
+                             header.requests};
+    std::memcpy(client.out.data() + reply_at, &reply_header, sizeof(reply_header));
+    frames_++;
+    requests_ += header.requests;
+    return true;
+}
@@ -0,0 +1,1312 @@
+#include "simulator.h"
+#include <iostream>
+#include <sstream>
+#include "benchmark.h"
+#include "checkpoint.h"
+#include "perf_counters.h"
+#include "trace_import.h"
+#include "fixed_cache.h"
+#include "cache_partition.h"
+#include <thread>
+
+Simulator::Simulator()
+    : active_(ActiveAllocator::PHYSICAL),
+      l1_ready_(false),
+      l2_ready_(false),
+      cache_specialize_(true),
+      vm_ready_(false),
+      numa_ready_(false),
+      dram_ready_(false),
+      frames_(phys_, buddy_, numa_) {}
+
+Simulator::~Simulator() {
+    if (telemetry_.running()) {
+        telemetry_.publish(snapshot());
+        telemetry_.stop();
+    }
+}
+
+
+//Drop resident pages whose frames live in an allocator that is being reset
+void Simulator::drop_frames_from(ActiveAllocator source) {
+    if (vm_ready_ && vm_.has_frame_provider() && frames_.source() == source)
+        vm_.set_frame_provider(&frames_);
+}
+
+//metrics of all components, for telemetry export
+TelemetrySnapshot Simulator::snapshot() const {
+    TelemetrySnapshot s{};
+    s.events = telemetry_.events();
+    if (l1_ready_) { s.l1_hits = l1_.hits(); s.l1_misses = l1_.misses(); }
+    if (l2_ready_) { s.l2_hits = l2_.hits(); s.l2_misses = l2_.misses(); }
+    if (vm_ready_) { s.page_hits = vm_.page_hits(); s.page_faults = vm_.page_faults(); }
+    switch (active_) {
+        case ActiveAllocator::PHYSICAL:
+            s.utilization = phys_.utilization();
+            s.fragmentation = phys_.external_fragmentation();
+            s.alloc_requests = phys_.alloc_requests();
+            s.failed_allocs = phys_.failed_allocs();
+            break;
+        case ActiveAllocator::BUDDY:
+            s.utilization = buddy_.utilization();
+            s.fragmentation = buddy_.external_fragmentation();
+            s.alloc_requests = buddy_.alloc_requests();
+            s.failed_allocs = buddy_.failed_allocs();
+            break;
+        case ActiveAllocator::NUMA:
+            s.utilization = numa_.utilization();
+            s.fragmentation = numa_.external_fragmentation();
+            s.alloc_requests = numa_.alloc_requests();
+            s.failed_allocs = numa_.failed_allocs();
+            break;
+    }
+    return s;
+}
+
+//Virtual to physical, faulting pages are placed on a NUMA node
+//(NUMA page frames place themselves when they are allocated)
+std::size_t Simulator::translate(std::size_t vaddr, bool warm) {
+    std::size_t paddr = warm ? vm_.warm(vaddr) : vm_.access(vaddr);
+    bool numa_frames = vm_.has_frame_provider() && frames_.source() == ActiveAllocator::NUMA;
+    if (numa_ready_ && !numa_frames && vm_.last_access_faulted())
+        numa_.place_page(vaddr / vm_.page_size());
+    return paddr;
+}
+
+//Charge a last level miss to its NUMA node and the DRAM, returns a note for the output
+//wait = the requester waits for the data (interactive commands); otherwise
+//requests stay queued so the DRAM scheduler can reorder them
+std::string Simulator::charge_memory(std::size_t address, std::size_t paddr, bool is_virtual, bool wait) {
+    std::string note;
+    if (dram_ready_) {
+        dram_.access(paddr);
+        if (wait) {
+            const char *outcomes[] = {"row hit", "row empty", "bank conflict"};
+            dram_.drain();
+            note += " (dram " + std::string(outcomes[static_cast<int>(dram_.last_outcome())]) +
+                    ", " + std::to_string(dram_.last_latency()) + " cycles)";
+        }
+    }
+    if (!numa_ready_)
+        return note;
+    std::size_t node = is_virtual ? numa_.page_node(address / vm_.page_size())
+                                  : numa_.node_of(address);
+    std::size_t latency = numa_.charge_access(node);
+    return note + " (node " + std::to_string(node) + ", latency " + std::to_string(latency) + ")";
+}
+
+//Allocation through the active allocator
+AllocId Simulator::allocate(std::size_t size) {
+    return (active_ == ActiveAllocator::PHYSICAL) ? phys_.malloc(size)
+         : (active_ == ActiveAllocator::BUDDY)    ? buddy_.malloc(size)
+                                                 : numa_.malloc(size);
+}
+
+bool Simulator::vm_frame(AllocId id) const {
+    return vm_ready_ && vm_.has_frame_provider() && frames_.source() == active_ && vm_.holds_frame(id);
+}
+
+bool Simulator::release(AllocId id) {
+    if (vm_frame(id))
+        return false;
+    return (active_ == ActiveAllocator::PHYSICAL) ? phys_.free_block(id)
+         : (active_ == ActiveAllocator::BUDDY)    ? buddy_.free_block(id)
+                                                 : numa_.free_block(id);
+}
+
+AllocId Simulator::allocate_aligned(std::size_t size, std::size_t alignment) {
+    return (active_ == ActiveAllocator::PHYSICAL) ? phys_.malloc_aligned(size, alignment)
+         : (active_ == ActiveAllocator::BUDDY)    ? buddy_.malloc_aligned(size, alignment)
+                                                 : numa_.malloc_aligned(size, alignment);
+}
+
+bool Simulator::resize(AllocId id, std::size_t size) {
+    if (vm_frame(id))
+        return false;
+    return (active_ == ActiveAllocator::PHYSICAL) ? phys_.realloc(id, size)
+         : (active_ == ActiveAllocator::BUDDY)    ? buddy_.realloc(id, size)
+                                                 : numa_.realloc(id, size);
+}
+
+bool Simulator::locate(AllocId id, std::size_t &address) const {
+    return (active_ == ActiveAllocator::PHYSICAL) ? phys_.address_of(id, address)
+         : (active_ == ActiveAllocator::BUDDY)    ? buddy_.address_of(id, address)
+                                                 : numa_.address_of(id, address);
+}
+
+//NUMA places every request on its own, so its batches are single calls
+std::size_t Simulator::allocate_batch(const std::vector<std::size_t> &sizes, std::vector<AllocId> &ids) {
+    if (active_ == ActiveAllocator::PHYSICAL)
+        return phys_.malloc_batch(sizes, ids);
+    if (active_ == ActiveAllocator::BUDDY)
+        return buddy_.malloc_batch(sizes, ids);
+    std::size_t done = 0;
+    ids.clear();
+    for (std::size_t size : sizes) {
+        ids.push_back(numa_.malloc(size));
+        done += ids.back() != INVALID_ID;
+    }
+    return done;
+}
+
+std::size_t Simulator::release_batch(const std::vector<AllocId> &ids) {
+    std::vector<AllocId> owned;
+    owned.reserve(ids.size());
+    for (AllocId id : ids) {
+        if (!vm_frame(id))
+            owned.push_back(id);
+    }
+    if (active_ == ActiveAllocator::PHYSICAL)
+        return phys_.free_batch(owned);
+    if (active_ == ActiveAllocator::BUDDY)
+        return buddy_.free_batch(owned);
+    std::size_t done = 0;
+    for (AllocId id : owned)
+        done += numa_.free_block(id);
+    return done;
+}
+
+
+SampleCounters Simulator::sample_counters() const {
+    SampleCounters c{l1_.hits(), l1_.misses(), l2_.hits(), l2_.misses(), 0, 0};
+    if (vm_ready_) {
+        c.page_hits = vm_.page_hits();
+        c.page_faults = vm_.page_faults();
+    }
+    return c;
+}
+
+//One reference in sampling mode (no per-access output)
+void Simulator::sampled_reference(std::size_t address, bool is_virtual, AccessType type) {
+    SamplePhase phase = sampler_.begin_reference(sample_counters());
+    if (phase == SamplePhase::FAST_FORWARD) {
+        if (sampler_.functional_warming()) {
+            std::size_t paddr = is_virtual ? translate(address, true) : address;
+            if (!l1_.warm(paddr))
+                l2_.warm(paddr);
+        }
+    } else {
+        std::size_t paddr = is_virtual ? translate(address, false) : address;
+        if (!l1_.access(paddr, type) && !l2_.access(paddr, type) && phase == SamplePhase::DETAIL)
+            charge_memory(address, paddr, is_virtual, false);
+    }
+    sampler_.end_reference(sample_counters());
+}
+
+ServedBy Simulator::reference(const TraceRecord &r, std::size_t &paddr) {
+    bool is_virtual = r.op == TraceOp::VACCESS;
+    if (!l1_ready_ || !l2_ready_ || (is_virtual && !vm_ready_))
+        return ServedBy::SKIPPED;
+    //streams are the tenants of partitioned caches
+    l1_.set_tenant(r.stream);
+    l2_.set_tenant(r.stream);
+    if (sampler_.enabled()) {
+        sampled_reference(r.value, is_virtual, r.type);
+        return ServedBy::SAMPLED;
+    }
+    paddr = is_virtual ? translate(r.value, false) : r.value;
+    if (l1_.access(paddr, r.type))
+        return ServedBy::L1;
+    if (l2_.access(paddr, r.type))
+        return ServedBy::L2;
+    charge_memory(r.value, paddr, is_virtual, false);
+    return ServedBy::MEMORY;
+}
+
+//Run the collected BATCH records as one batch call
+void Simulator::replay_batch(ReplayCounts &counts) {
+    std::vector<TraceRecord> records;
+    std::vector<std::size_t> slots;
+    records.swap(counts.batch);
+    slots.swap(counts.batch_slots);
+    counts.batch_left = 0;
+    if (records.empty())
+        return;
+    std::vector<RecordResult> *results = counts.results;
+
+    if (records.front().op == TraceOp::MALLOC) {
+        std::vector<std::size_t> sizes;
+        std::vector<AllocId> ids;
+        for (const TraceRecord &r : records)
+            sizes.push_back(r.value);
+        std::size_t done = allocate_batch(sizes, ids);
+        counts.failed += sizes.size() - done;
+        counts.ids.insert(counts.ids.end(), ids.begin(), ids.end());
+        if (results) {
+            (*results)[counts.batch_slot].value = done;
+            for (std::size_t k = 0; k < ids.size(); k++)
+                (*results)[slots[k]] = {ids[k] != INVALID_ID, ServedBy::SKIPPED, ids[k]};
+        }
+        return;
+    }
+
+    std::vector<AllocId> ids;
+    std::vector<std::size_t> id_slots;
+    for (std::size_t k = 0; k < records.size(); k++) {
+        const TraceRecord &r = records[k];
+        if (r.value >= counts.ids.size() || counts.ids[r.value] == INVALID_ID) {
+            counts.bad_frees++;
+            if (results)
+                (*results)[slots[k]].value = INVALID_ID;
+            continue;
+        }
+        ids.push_back(counts.ids[r.value]);
+        counts.ids[r.value] = INVALID_ID;
+        if (results)
+            id_slots.push_back(slots[k]);
+    }
+
+    //an id the allocator knew before the batch and not after it was freed
+    std::vector<bool> known;
+    std::size_t address = 0;
+    if (results) {
+        for (AllocId id : ids)
+            known.push_back(locate(id, address));
+    }
+    std::size_t done = release_batch(ids);
+    counts.bad_frees += ids.size() - done;
+    if (results) {
+        (*results)[counts.batch_slot].value = done;
+        for (std::size_t i = 0; i < ids.size(); i++)
+            (*results)[id_slots[i]] = {known[i] && !locate(ids[i], address), ServedBy::SKIPPED, ids[i]};
+    }
+}
+
+//One trace record, without per-record output
+void Simulator::replay_record(const TraceRecord &r, ReplayCounts &counts) {
+    if (telemetry_.tick())
+        telemetry_.publish(snapshot());
+    counts.records++;
+
+    //daemon answer, filled in below (batched records when their batch runs)
+    RecordResult *result = nullptr;
+    if (counts.results) {
+        counts.results->push_back(RecordResult{false, ServedBy::SKIPPED, 0});
+        result = &counts.results->back();
+    }
+
+    if (counts.batch_left > 0) {
+        bool same_op = counts.batch.empty() || counts.batch.front().op == r.op;
+        if ((r.op == TraceOp::MALLOC || r.op == TraceOp::FREE) && same_op) {
+            counts.batch.push_back(r);
+            if (counts.results)
+                counts.batch_slots.push_back(counts.results->size() - 1);
+            if (--counts.batch_left == 0)
+                replay_batch(counts);
+            return;
+        }
+        //a batch cut short runs with what it has
+        replay_batch(counts);
+    }
+
+    switch (r.op) {
+        case TraceOp::MALLOC:
+        case TraceOp::MALLOC_ALIGNED: {
+            AllocId id = (r.op == TraceOp::MALLOC) ? allocate(r.value) : allocate_aligned(r.value, r.arg);
+            if (id == INVALID_ID) counts.failed++;
+            counts.ids.push_back(id);
+            if (result)
+                *result = {id != INVALID_ID, ServedBy::SKIPPED, id};
+            break;
+        }
+        case TraceOp::REALLOC:
+            if (r.value >= counts.ids.size() || counts.ids[r.value] == INVALID_ID)
+                counts.bad_frees++;
+            else if (!resize(counts.ids[r.value], r.arg))
+                counts.failed++;
+            else if (result) {
+                std::size_t address = 0;
+                result->ok = locate(counts.ids[r.value], address);
+                result->value = address;
+            }
+            break;
+        case TraceOp::BATCH:
+            counts.batch_left = r.value;
+            if (result) {
+                counts.batch_slot = counts.results->size() - 1;
+                result->ok = true;
+            }
+            break;
+        case TraceOp::FREE: {
+            AllocId id = (r.value < counts.ids.size()) ? counts.ids[r.value] : INVALID_ID;
+            if (id == INVALID_ID || !release(id)) {
+                counts.bad_frees++;
+            } else {
+                counts.ids[r.value] = INVALID_ID;
+                if (result) result->ok = true;
+            }
+            if (result) result->value = id;
+            break;
+        }
+        case TraceOp::ACCESS:
+        case TraceOp::VACCESS: {
+            std::size_t paddr = 0;
+            ServedBy served = reference(r, paddr);
+            if (served == ServedBy::SKIPPED)
+                counts.skipped++;
+            if (result)
+                *result = {served != ServedBy::SKIPPED, served, paddr};
+            break;
+        }
+    }
+}
+
+void Simulator::replay_summary(ReplayCounts &counts, std::chrono::steady_clock::time_point start) {
+    //a batch at the very end of the trace may be cut short
+    replay_batch(counts);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Replayed " << counts.records << " records in " << ms << " ms ("
+              << (ms > 0 ? counts.records / ms / 1000.0 : 0.0) << " M records/s)\n";
+    if (counts.failed > 0)
+        std::cout << "Failed allocations: " << counts.failed << "\n";
+    if (counts.bad_frees > 0)
+        std::cout << "Invalid frees: " << counts.bad_frees << "\n";
+    if (counts.skipped > 0)
+        std::cout << "Skipped accesses (caches or VM not initialized): " << counts.skipped << "\n";
+    if (dram_ready_) {
+        dram_.drain();
+        std::cout << "DRAM requests: " << dram_.requests() << ", row hit rate "
+                  << dram_.row_hit_rate() * 100 << "%\n";
+    }
+}
+
+
+//Daemon requests
+void Simulator::apply(const std::vector<TraceRecord> &records, std::vector<RecordResult> &results) {
+    results.clear();
+    results.reserve(records.size());
+    session_.results = &results;
+    for (const TraceRecord &r : records)
+        replay_record(r, session_);
+    //the end of a call is the end of a trace for a batch
+    replay_batch(session_);
+    session_.results = nullptr;
+}
+
+
+//REPL commands
+bool Simulator::execute(const std::string &line) {
+    std::stringstream ss(line);
+    std::string cmd;
+    ss >> cmd;
+
+    if (telemetry_.tick())
+        telemetry_.publish(snapshot());
+    //----
+    if (cmd == "exit") {
+        return false;
+    }
+    //----
+    else if (cmd == "vm") {
+        std::string sub;
+        ss >> sub;
+
+        if (sub == "init") {
+            std::size_t page_size, num_pages;
+            ss >> page_size >> num_pages;
+
+            vm_ready_ = vm_.init(page_size, num_pages);
+            if (!vm_ready_)
+                return true;
+
+            //page frames come from the active allocator once it has memory
+            bool has_memory = (active_ == ActiveAllocator::PHYSICAL) ? phys_.total_size() > 0
+                            : (active_ == ActiveAllocator::BUDDY)    ? buddy_.total_size() > 0
+                                                                    : numa_ready_;
+            frames_.set_source(active_);
+            vm_.set_frame_provider(has_memory ? &frames_ : nullptr);
+            std::cout << "Virtual memory initialized"
+                      << (has_memory ? " (frames from active allocator)" : "") << "\n";
+        }
+        else if (sub == "stats") {
+            if (vm_ready_)
+                vm_.stats();
+            else
+                std::cout << "Virtual memory not initialized\n";
+        }
+        else if (!vm_ready_) {
+            std::cout << "Virtual memory not initialized\n";
+        }
+        else if (sub == "wss") {
+            //vm wss on <exact|sampled> <window> [scan_interval] | off | export <prefix>
+            std::string mode, arg;
+            std::size_t window = 0, scan = 0;
+            ss >> mode;
+            if (mode == "on") {
+                ss >> arg >> window;
+                if (!(ss >> scan))
+                    scan = (window >= 4) ? window / 4 : 1;
+                bool valid_mode = (arg == "exact" || arg == "sampled");
+                if (valid_mode && vm_.start_tracking(arg == "exact" ? TrackMode::EXACT : TrackMode::SAMPLED,
+                                                    window, scan))
+                    std::cout << "Working set tracking (" << arg << "): window " << window
+                              << ", scan every " << scan << " references\n";
+                else
+                    std::cout << "Usage: vm wss on <exact|sampled> <window> [scan_interval <= window]\n";
+            }
+            else if (mode == "off") {
+                vm_.stop_tracking();
+                std::cout << "Working set tracking stopped\n";
+            }
+            else if (mode == "export") {
+                ss >> arg;
+                if (arg.empty())
+                    std::cout << "Usage: vm wss export <prefix>\n";
+                else if (vm_.tracker().export_csv(arg))
+                    std::cout << "Exported " << arg << "_wss.csv, " << arg << "_heat.csv, " << arg << "_idle.csv\n";
+                else
+                    std::cout << "Export failed (tracking off or file not writable)\n";
+            }
+            else {
+                vm_.tracker().stats(vm_.page_size());
+            }
+        }
+        else if (sub == "heatmap") {
+            std::size_t columns = 64;
+            ss >> columns;
+            vm_.tracker().heatmap(columns > 0 ? columns : 64);
+        }
+        else {
+            std::cout << "Unknown vm command\n";
+        }
+    }
+    //----
+    else if (cmd == "vaccess") {
+        std::size_t vaddr;
+        ss >> vaddr;
+
+        if (!vm_ready_) {
+            std::cout << "Virtual memory not initialized\n";
+            return true;
+        }
+        if (!l1_ready_ || !l2_ready_) {
+            std::cout << "Caches not initialized\n";
+            return true;
+        }
+
+        if (sampler_.enabled()) {
+            sampled_reference(vaddr, true, AccessType::READ);
+            return true;
+        }
+
+        //Virtual to Physical
+        std::size_t paddr = translate(vaddr, false);
+        std::cout << (vm_.last_access_faulted() ? "PAGE FAULT" : "PAGE HIT");
+        //Cache hierarchy
+        if (l1_.access(paddr)) {
+            std::cout << " → L1 HIT\n";
+        }
+        else {
+            if (l2_.access(paddr)) {
+                std::cout << " → L1 MISS → L2 HIT\n";
+            }
+            else {
+                std::cout << " → L1 MISS → L2 MISS → MEMORY ACCESS"
+                          << charge_memory(vaddr, paddr, true, true) << "\n";
+            }
+        }
+    }
+    //----
+    else if (cmd == "stats") {
+        if (active_ == ActiveAllocator::PHYSICAL)
+            phys_.stats();
+        else if (active_ == ActiveAllocator::BUDDY)
+            buddy_.stats();
+        else
+            numa_.stats();
+    }
+    //----
+    else if (cmd == "init") {
+        std::string word;
+        std::size_t size;
+
+        if (!(ss >> word >> size) || word != "memory") {
+            std::cout << "Usage: init memory <size>\n";
+        } else {
+            drop_frames_from(ActiveAllocator::PHYSICAL);
+            drop_frames_from(ActiveAllocator::BUDDY);
+            phys_.init(size);
+            buddy_.init(size);  
+            active_ = ActiveAllocator::PHYSICAL;
+            std::cout << "Initialized memory of size " << size << "\n";
+        }
+    }
+    //----
+    else if (cmd == "set") {
+        std::string what, type;
+        ss >> what >> type;
+        if (what == "compaction") {
+            if (type == "off") {
+                phys_.set_compaction(CompactionPolicy::OFF);
+            }
+            else if (type == "on_failure") {
+                phys_.set_compaction(CompactionPolicy::ON_FAILURE);
+            }
+            else if (type == "threshold") {
+                double percent = 50.0;
+                ss >> percent;
+                phys_.set_compaction(CompactionPolicy::THRESHOLD, percent / 100.0);
+            }
+            else {
+                std::cout << "Usage: set compaction <off|on_failure|threshold [percent]>\n";
+                return true;
+            }
+            std::cout << "Compaction policy set to " << type << "\n";
+        }
+        else if (what != "allocator") {
+            std::cout << "Usage: set allocator <type>\n";
+        }
+        else if (type == "buddy") {
+            active_ = ActiveAllocator::BUDDY;
+            std::cout << "Switched to Buddy Allocator\n";
+        }
+        else if (type == "numa") {
+            if (!numa_ready_) {
+                std::cout << "NUMA memory not initialized\n";
+                return true;
+            }
+            active_ = ActiveAllocator::NUMA;
+            std::cout << "Switched to NUMA Allocator\n";
+        }
+        else {
+            active_ = ActiveAllocator::PHYSICAL;
+            if (type == "first_fit")
+                phys_.set_allocator(AllocatorType::FIRST_FIT);
+            else if (type == "best_fit")
+                phys_.set_allocator(AllocatorType::BEST_FIT);
+            else if (type == "worst_fit")
+                phys_.set_allocator(AllocatorType::WORST_FIT);
+            else {
+                std::cout << "Unknown allocator\n";
+                return true;
+            }
+            std::cout << "Switched to Physical Allocator (" << type << ")\n";
+        }
+    }
+    //----
+    else if (cmd == "malloc") {
+        std::size_t size;
+        ss >> size;
+        AllocId id = allocate(size);
+        if (id == INVALID_ID) {
+            std::cout << "Allocation failed\n";
+        } else {
+            std::cout << "Allocated block id=" << id << "\n";
+        }
+    }
+    //----
+    else if (cmd == "free") {
+        AllocId id = INVALID_ID;
+        ss >> id;
+        if (vm_frame(id))
+            std::cout << "Block id=" << id << " is a page frame of the virtual memory\n";
+        else
+            std::cout << (release(id) ? "Block freed\n" : "Invalid block id\n");
+    }
+    //----
+    else if (cmd == "malloc_aligned") {
+        std::size_t size = 0, alignment = 0;
+        ss >> size >> alignment;
+        AllocId id = allocate_aligned(size, alignment);
+        std::size_t address = 0;
+        if (id == INVALID_ID || !locate(id, address)) {
+            std::cout << "Allocation failed (alignment must be a power of two)\n";
+        } else {
+            std::cout << "Allocated block id=" << id << " at address " << address << "\n";
+        }
+    }
+    //----
+    else if (cmd == "realloc") {
+        AllocId id = INVALID_ID;
+        std::size_t size = 0, before = 0, after = 0;
+        ss >> id >> size;
+        if (!locate(id, before)) {
+            std::cout << "Invalid block id\n";
+        } else if (vm_frame(id)) {
+            std::cout << "Block id=" << id << " is a page frame of the virtual memory\n";
+        } else if (!resize(id, size) || !locate(id, after)) {
+            std::cout << "Reallocation failed\n";
+        } else if (after == before) {
+            std::cout << "Block id=" << id << " resized in place\n";
+        } else {
+            std::cout << "Block id=" << id << " moved from address " << before << " to " << after << "\n";
+        }
+    }
+    //----
+    else if (cmd == "malloc_batch") {
+        std::vector<std::size_t> sizes;
+        std::vector<AllocId> ids;
+        std::size_t size = 0;
+        while (ss >> size)
+            sizes.push_back(size);
+        if (sizes.empty()) {
+            std::cout << "Usage: malloc_batch <size> [size ...]\n";
+        } else {
+            std::size_t done = allocate_batch(sizes, ids);
+            std::cout << "Allocated " << done << " of " << sizes.size() << " blocks, ids:";
+            for (AllocId id : ids) {
+                if (id == INVALID_ID)
+                    std::cout << " failed";
+                else
+                    std::cout << " " << id;
+            }
+            std::cout << "\n";
+        }
+    }
+    //----
+    else if (cmd == "free_batch") {
+        std::vector<AllocId> ids;
+        AllocId id = INVALID_ID;
+        while (ss >> id)
+            ids.push_back(id);
+        if (ids.empty())
+            std::cout << "Usage: free_batch <id> [id ...]\n";
+        else
+            std::cout << "Freed " << release_batch(ids) << " of " << ids.size() << " blocks\n";
+    }
+    //----
+    else if (cmd == "compact") {
+        if (active_ == ActiveAllocator::PHYSICAL) {
+            std::size_t moved = phys_.compact();
+            std::cout << "Memory compacted, moved " << moved << " bytes\n";
+        } else {
+            std::cout << "Compaction not supported by this allocator\n";
+        }
+    }
+    //----
+    else if (cmd == "dump") {
+        if (active_ == ActiveAllocator::PHYSICAL)
+            phys_.dump();
+        else if (active_ == ActiveAllocator::BUDDY)
+            buddy_.dump();
+        else
+            numa_.dump();
+    }
+    //----
+    else if (cmd == "numa") {
+        std::string sub;
+        ss >> sub;
+
+        if (sub == "init") {
+            std::size_t nodes = 0, node_size = 0;
+            ss >> nodes >> node_size;
+            drop_frames_from(ActiveAllocator::NUMA);
+            numa_ready_ = numa_.init(nodes, node_size);
+            if (numa_ready_)
+                std::cout << "NUMA memory initialized with " << nodes << " nodes\n";
+        }
+        else if (!numa_ready_) {
+            std::cout << "NUMA memory not initialized\n";
+        }
+        else if (sub == "policy") {
+            std::string policy;
+            std::size_t node = 0;
+            ss >> policy >> node;
+            if (policy == "local")
+                numa_.set_policy(NumaPolicy::LOCAL);
+            else if (policy == "interleave")
+                numa_.set_policy(NumaPolicy::INTERLEAVE);
+            else if (policy == "preferred")
+                numa_.set_policy(NumaPolicy::PREFERRED, node);
+            else if (policy == "first_touch")
+                numa_.set_policy(NumaPolicy::FIRST_TOUCH);
+            else {
+                std::cout << "Usage: numa policy <local|interleave|preferred <node>|first_touch>\n";
+                return true;
+            }
+            std::cout << "NUMA policy set to " << policy << "\n";
+        }
+        else if (sub == "engine") {
+            std::string type;
+            ss >> type;
+            bool ok = false;
+            drop_frames_from(ActiveAllocator::NUMA);
+            if (type == "first_fit")
+                ok = numa_.set_engine(NumaEngine::PHYSICAL, AllocatorType::FIRST_FIT);
+            else if (type == "best_fit")
+                ok = numa_.set_engine(NumaEngine::PHYSICAL, AllocatorType::BEST_FIT);
+            else if (type == "worst_fit")
+                ok = numa_.set_engine(NumaEngine::PHYSICAL, AllocatorType::WORST_FIT);
+            else if (type == "buddy")
+                ok = numa_.set_engine(NumaEngine::BUDDY, AllocatorType::FIRST_FIT);
+            else
+                std::cout << "Unknown allocator\n";
+            if (ok)
+                std::cout << "NUMA node allocator set to " << type << "\n";
+        }
+        else if (sub == "cpu") {
+            std::size_t node = 0;
+            ss >> node;
+            if (numa_.set_cpu_node(node))
+                std::cout << "Running on node " << node << "\n";
+            else
+                std::cout << "Invalid node\n";
+        }
+        else if (sub == "latency") {
+            std::size_t local = 0, remote = 0;
+            if (ss >> local >> remote) {
+                numa_.set_latency(local, remote);
+                std::cout << "NUMA latency set to " << local << "/" << remote << "\n";
+            } else {
+                std::cout << "Usage: numa latency <local> <remote>\n";
+            }
+        }
+        else if (sub == "stats") {
+            numa_.stats();
+        }
+        else if (sub == "dump") {
+            numa_.dump();
+        }
+        else {
+            std::cout << "Unknown numa command\n";
+        }
+    }
+    //----
+    else if (cmd == "buddy") {
+        std::string sub;
+        ss >> sub;
+        auto zone_of = [](const std::string &name, ZoneType &zone) {
+            if (name == "dma")
+                zone = ZoneType::DMA;
+            else if (name == "normal")
+                zone = ZoneType::NORMAL;
+            else if (name == "movable")
+                zone = ZoneType::MOVABLE;
+            else
+                return false;
+            return true;
+        };
+
+        if (buddy_.total_size() == 0) {
+            std::cout << "Memory not initialized\n";
+        }
+        else if (sub == "zones") {
+            std::size_t dma = 0, movable = 0;
+            if (!(ss >> dma >> movable)) {
+                std::cout << "Usage: buddy zones <dma_bytes> <movable_bytes>\n";
+            } else if (!buddy_.zones_valid(dma, movable)) {
+                std::cout << "Invalid zone sizes (the normal zone must not be empty)\n";
+            } else {
+                drop_frames_from(ActiveAllocator::BUDDY);
+                buddy_.set_zones(dma, movable);
+                std::cout << "Buddy zones: DMA " << dma << ", Normal " << buddy_.total_size() - dma - movable
+                          << ", Movable " << movable << "\n";
+            }
+        }
+        else if (sub == "watermark") {
+            std::string name;
+            std::size_t min = 0;
+            ZoneType zone = ZoneType::NORMAL;
+            if (!(ss >> name >> min) || !zone_of(name, zone))
+                std::cout << "Usage: buddy watermark <dma|normal|movable> <min_bytes>\n";
+            else if (buddy_.set_watermark(zone, min))
+                std::cout << "Watermarks of " << name << " set to " << min << "/" << min + min / 4 << "/"
+                          << min + min / 2 << "\n";
+            else
+                std::cout << "No " << name << " zone\n";
+        }
+        else if (sub == "malloc") {
+            std::string name;
+            std::size_t size = 0;
+            ZoneType zone = ZoneType::NORMAL;
+            if (!(ss >> name >> size) || !zone_of(name, zone)) {
+                std::cout << "Usage: buddy malloc <dma|normal|movable> <size>\n";
+            } else {
+                AllocId id = buddy_.malloc_zone(size, zone);
+                std::size_t address = 0;
+                if (id == INVALID_ID || !buddy_.address_of(id, address))
+                    std::cout << "Allocation failed\n";
+                else
+                    std::cout << "Allocated block id=" << id << " at address " << address << "\n";
+            }
+        }
+        else {
+            std::cout << "Unknown buddy command\n";
+        }
+    }
+    //----
+    else if (cmd == "cache") {
+        std::string sub;
+        ss >> sub;
+
+        if (sub == "init") {
+            std::string level;
+            std::size_t cache_size, block_size, ways;
+            ss >> level >> cache_size >> block_size >> ways;
+
+            if (level == "L1") {
+                l1_ready_ = l1_.init("L1", cache_size, block_size, ways, cache_specialize_);
+                if (l1_ready_) std::cout << "L1 cache initialized\n";
+            }
+            else if (level == "L2") {
+                l2_ready_ = l2_.init("L2", cache_size, block_size, ways, cache_specialize_);
+                if (l2_ready_) std::cout << "L2 cache initialized\n";
+            }
+            else {
+                std::cout << "Unknown cache level\n";
+            }
+        }
+        else if (sub == "dump") {
+            if (l1_ready_) l1_.dump();
+            if (l2_ready_) l2_.dump();
+        }
+        else if (sub == "stats") {
+            if (l1_ready_) l1_.stats();
+            if (l2_ready_) l2_.stats();
+        }
+        else if (sub == "specialize") {
+            std::string mode;
+            ss >> mode;
+            if (mode == "on" || mode == "off") {
+                cache_specialize_ = (mode == "on");
+                std::cout << "Specialized cache geometries " << (cache_specialize_ ? "enabled" : "disabled")
+                          << " for the next cache init\n";
+            } else {
+                std::cout << "Usage: cache specialize <on|off>\n";
+            }
+        }
+        else if (sub == "kernels") {
+            list_cache_kernels();
+        }
+        else if (sub == "classify" || sub == "victim") {
+            std::string level, arg;
+            ss >> level >> arg;
+            Cache *cache = (level == "L1" && l1_ready_) ? &l1_ : (level == "L2" && l2_ready_) ? &l2_ : nullptr;
+
+            std::size_t entries = 0;
+            std::stringstream parse(arg);
+            bool valid_entries = static_cast<bool>(parse >> entries);
+
+            if (!cache) {
+                std::cout << "Cache level not initialized\n";
+            }
+            else if (sub == "classify" && (arg == "on" || arg == "off")) {
+                cache->set_classification(arg == "on");
+                std::cout << level << " miss classification " << (arg == "on" ? "enabled" : "disabled") << "\n";
+            }
+            else if (sub == "victim" && valid_entries) {
+                cache->set_victim(entries);
+                if (entries)
+                    std::cout << level << " victim cache: " << entries << " entries\n";
+                else
+                    std::cout << level << " victim cache detached\n";
+            }
+            else if (sub == "classify") {
+                std::cout << "Usage: cache classify <L1|L2> <on|off>\n";
+            }
+            else {
+                std::cout << "Usage: cache victim <L1|L2> <entries>\n";
+            }
+        }
+        else if (sub == "partition" || sub == "ucp") {
+            //cache partition <L1|L2> <tenant> <hex mask> | cache partition <L1|L2> off
+            //cache ucp <L1|L2> <interval>
+            std::string level, arg, mask_arg;
+            ss >> level >> arg >> mask_arg;
+            Cache *cache = (level == "L1" && l1_ready_) ? &l1_ : (level == "L2" && l2_ready_) ? &l2_ : nullptr;
+
+            std::uint64_t number = 0, mask = 0;
+            std::stringstream parse(arg), parse_mask(mask_arg);
+            bool valid_number = static_cast<bool>(parse >> number);
+            bool valid_mask = static_cast<bool>(parse_mask >> std::hex >> mask);
+
+            if (!cache) {
+                std::cout << "Cache level not initialized\n";
+            }
+            else if (sub == "partition" && arg == "off") {
+                cache->clear_partitioning();
+                std::cout << level << " way partitioning disabled\n";
+            }
+            else if (sub == "partition" && valid_number && valid_mask) {
+                if (cache->set_way_mask(static_cast<std::uint32_t>(number), mask))
+                    std::cout << level << " tenant " << number << " ways: 0x" << std::hex << mask << std::dec << "\n";
+                else
+                    std::cout << "Invalid way mask (tenant < 16, non-empty, contiguous, within the ways)\n";
+            }
+            else if (sub == "ucp" && valid_number) {
+                if (!cache->set_ucp(number))
+                    std::cout << "Way partitioning needs at most 64 ways\n";
+                else if (number)
+                    std::cout << level << " UCP repartitioning every " << number << " references\n";
+                else
+                    std::cout << level << " UCP disabled, masks are static\n";
+            }
+            else if (sub == "partition") {
+                std::cout << "Usage: cache partition <L1|L2> <tenant> <hex mask> | cache partition <L1|L2> off\n";
+            }
+            else {
+                std::cout << "Usage: cache ucp <L1|L2> <interval>\n";
+            }
+        }
+        else {
+            std::cout << "Unknown cache command\n";
+        }
+    }
+    //----
+    else if (cmd == "dram") {
+        std::string sub;
+        ss >> sub;
+
+        if (sub == "init") {
+            std::size_t channels = 0, ranks = 0, banks = 0, row_bytes = 0, rows = 65536;
+            ss >> channels >> ranks >> banks >> row_bytes >> rows;
+            dram_ready_ = dram_.init(channels, ranks, banks, row_bytes, rows);
+            if (dram_ready_)
+                std::cout << "DRAM initialized: " << channels << " channels, " << ranks << " ranks, "
+                          << banks << " banks\n";
+        }
+        else if (!dram_ready_) {
+            std::cout << "DRAM not initialized\n";
+        }
+        else if (sub == "map") {
+            std::string scheme;
+            ss >> scheme;
+            dram_.drain();
+            if (dram_.set_mapping(scheme))
+                std::cout << "DRAM address mapping set to " << scheme << "\n";
+            else
+                std::cout << "Usage: dram map <scheme> (Ro, Ra, Ba, Ch, Co once each, e.g. RoRaBaChCo)\n";
+        }
+        else if (sub == "policy") {
+            std::string policy;
+            ss >> policy;
+            if (policy == "open" || policy == "closed") {
+                dram_.drain();
+                dram_.set_policy(policy == "open" ? PagePolicy::OPEN : PagePolicy::CLOSED);
+                std::cout << "DRAM page policy set to " << policy << "\n";
+            } else {
+                std::cout << "Usage: dram policy <open|closed>\n";
+            }
+        }
+        else if (sub == "sched") {
+            std::string scheduler;
+            ss >> scheduler;
+            if (scheduler == "frfcfs" || scheduler == "fcfs") {
+                dram_.drain();
+                dram_.set_scheduler(scheduler == "frfcfs" ? DramScheduler::FR_FCFS : DramScheduler::FCFS);
+                std::cout << "DRAM scheduler set to " << scheduler << "\n";
+            } else {
+                std::cout << "Usage: dram sched <frfcfs|fcfs>\n";
+            }
+        }
+        else if (sub == "timing") {
+            std::uint32_t cl = 0, rcd = 0, rp = 0, burst = 0;
+            ss >> cl >> rcd >> rp >> burst;
+            if (dram_.set_timing(cl, rcd, rp, burst))
+                std::cout << "DRAM timing set to " << cl << "-" << rcd << "-" << rp << ", burst " << burst << "\n";
+            else
+                std::cout << "Usage: dram timing <tCL> <tRCD> <tRP> <tBURST>\n";
+        }
+        else if (sub == "queue") {
+            std::size_t depth = 0, gap = 0;
+            if (ss >> depth >> gap && dram_.set_queue(depth, gap))
+                std::cout << "DRAM queue depth " << depth << ", arrival gap " << gap << " cycles\n";
+            else
+                std::cout << "Usage: dram queue <depth> <arrival gap>\n";
+        }
+        else if (sub == "stats") {
+            dram_.drain();
+            dram_.stats();
+        }
+        else if (sub == "reset") {
+            dram_.reset();
+            std::cout << "DRAM reset\n";
+        }
+        else {
+            std::cout << "Unknown dram command\n";
+        }
+    }
+    //----
+    else if (cmd == "access") {
+        std::size_t address;
+        ss >> address;
+
+        if (!l1_ready_ || !l2_ready_) {
+            std::cout << "Caches not initialized\n";
+            return true;
+        }
+        if (sampler_.enabled()) {
+            sampled_reference(address, false, AccessType::READ);
+        }
+        else if (l1_.access(address)) {
+            std::cout << "L1 HIT\n";
+        }
+        else {
+            std::cout << "L1 MISS → ";
+            if (l2_.access(address)) {
+                std::cout << "L2 HIT\n";
+            }
+            else {
+                std::cout << "L2 MISS → MEMORY ACCESS" << charge_memory(address, address, false, true) << "\n";
+            }
+        }
+    }
+    //----
+    else if (cmd == "stream") {
+        //tenant of the following accesses, like a trace stream id
+        std::uint32_t stream = 0;
+        if (ss >> stream) {
+            l1_.set_tenant(stream);
+            l2_.set_tenant(stream);
+            std::cout << "Stream " << stream << " (tenant " << WayPartition::tenant_of(stream) << ")\n";
+        } else {
+            std::cout << "Usage: stream <id>\n";
+        }
+    }
+    //----
+    else if (cmd == "sample") {
+        std::string sub;
+        ss >> sub;
+
+        if (sub == "on") {
+            std::uint64_t fast_forward = 0, warmup = 0, detail = 0;
+            std::string mode;
+            if (!(ss >> fast_forward >> warmup >> detail)) {
+                std::cout << "Usage: sample on <fast_forward> <warmup> <detail> [skip]\n";
+                return true;
+            }
+            ss >> mode;
+            if (sampler_.init(fast_forward, warmup, detail, mode != "skip"))
+                std::cout << "Sampling enabled\n";
+        }
+        else if (sub == "off") {
+            sampler_.disable();
+            std::cout << "Sampling disabled\n";
+        }
+        else if (sub == "report") {
+            sampler_.report();
+        }
+        else {
+            std::cout << "Unknown sample command\n";
+        }
+    }
+    //----
+    else if (cmd == "save") {
+        std::string path;
+        ss >> path;
+        if (path.empty()) {
+            std::cout << "Usage: save <file>\n";
+            return true;
+        }
+
+        CheckpointWriter out;
+        out.begin_section(CheckpointSection::REPL);
+        out.put(active_);
+        out.put(static_cast<std::uint8_t>(l1_ready_));
+        out.put(static_cast<std::uint8_t>(l2_ready_));
+        out.put(static_cast<std::uint8_t>(vm_ready_));
+        out.put(static_cast<std::uint8_t>(numa_ready_));
+        out.put(static_cast<std::uint8_t>(dram_ready_));
+        out.put(static_cast<std::uint8_t>(vm_.has_frame_provider()));
+        out.put(frames_.source());
+        phys_.save(out);
+        buddy_.save(out);
+        if (l1_ready_) l1_.save(out);
+        if (l2_ready_) l2_.save(out);
+        if (vm_ready_) vm_.save(out);
+        if (numa_ready_) numa_.save(out);
+        if (dram_ready_) {
+            dram_.drain();
+            dram_.save(out);
+        }
+
+        if (out.write_file(path))
+            std::cout << "Checkpoint saved to " << path << "\n";
+        else
+            std::cout << "Failed to write checkpoint " << path << "\n";
+    }
+    //----
+    else if (cmd == "load") {
+        std::string path;
+        ss >> path;
+
+        CheckpointReader in;
+        if (path.empty() || !in.open(path)) {
+            std::cout << "Invalid checkpoint file\n";
+            return true;
+        }
+
+        //restore into fresh components, current state survives a bad file
+        ActiveAllocator saved_active = ActiveAllocator::PHYSICAL;
+        std::uint8_t has_l1 = 0, has_l2 = 0, has_vm = 0, has_numa = 0, has_dram = 0, vm_frames = 0;
+        ActiveAllocator frame_source = ActiveAllocator::PHYSICAL;
+        PhysicalMemory saved_phys;
+        BuddyAllocator saved_buddy;
+        Cache saved_l1, saved_l2;
+        VirtualMemory saved_vm;
+        NumaMemory saved_numa;
+        Dram saved_dram;
+
+        bool ok = in.expect_section(CheckpointSection::REPL) &&
+                  in.get(saved_active) && in.get(has_l1) &&
+                  in.get(has_l2) && in.get(has_vm) && in.get(has_numa) && in.get(has_dram) &&
+                  in.get(vm_frames) && in.get(frame_source) &&
+                  saved_phys.load(in) && saved_buddy.load(in) &&
+                  (!has_l1 || saved_l1.load(in)) &&
+                  (!has_l2 || saved_l2.load(in)) &&
+                  (!has_vm || saved_vm.load(in, vm_frames ? &frames_ : nullptr)) &&
+                  (!has_numa || saved_numa.load(in)) &&
+                  (!has_dram || saved_dram.load(in));
+        if (!ok) {
+            std::cout << "Corrupt checkpoint " << path << "\n";
+            return true;
+        }
+
+        active_ = saved_active;
+        phys_ = std::move(saved_phys);
+        buddy_ = std::move(saved_buddy);
+        l1_ = std::move(saved_l1);
+        l2_ = std::move(saved_l2);
+        vm_ = std::move(saved_vm);
+        numa_ = std::move(saved_numa);
+        dram_ = std::move(saved_dram);
+        frames_.set_source(frame_source);
+        l1_ready_ = has_l1;
+        l2_ready_ = has_l2;
+        vm_ready_ = has_vm;
+        numa_ready_ = has_numa;
+        dram_ready_ = has_dram;
+        std::cout << "Checkpoint loaded from " << path << "\n";
+    }
+    //----
+    else if (cmd == "trace") {
+        std::string sub, in_path, out_path;
+        ss >> sub >> in_path >> out_path;
+
+        TraceReader reader;
+        if (sub == "import") {
+            //in_path holds the format, out_path the trace file
+            std::string mode;
+            ss >> mode;
+            ImportFormat format = ImportFormat::DINERO;
+            TraceImporter importer;
+            std::vector<TraceRecord> batch;
+
+            if (in_path == "din")
+                format = ImportFormat::DINERO;
+            else if (in_path == "lackey")
+                format = ImportFormat::LACKEY;
+            else if (in_path == "champsim")
+                format = ImportFormat::CHAMPSIM;
+            else
+                out_path.clear();
+
+            if (out_path.empty()) {
+                std::cout << "Usage: trace import <din|lackey|champsim> <file> [virtual]\n";
+            }
+            else if (!importer.open(out_path, format, mode == "virtual")) {
+                std::cout << "Cannot open " << out_path << "\n";
+            }
+            else {
+                ReplayCounts counts;
+                auto start = std::chrono::steady_clock::now();
+                while (importer.next(batch)) {
+                    for (const TraceRecord &r : batch)
+                        replay_record(r, counts);
+                }
+                replay_summary(counts, start);
+                if (importer.skipped() > 0)
+                    std::cout << "Unrecognized trace entries: " << importer.skipped() << "\n";
+            }
+        }
+        else if (sub == "convert") {
+            if (in_path.empty() || out_path.empty())
+                std::cout << "Usage: trace convert <commands.txt> <out.mst>\n";
+            else if (!trace_convert_text(in_path, out_path))
+                std::cout << "Cannot convert " << in_path << "\n";
+        }
+        else if (sub != "replay") {
+            std::cout << "Usage: trace convert <commands.txt> <out.mst> | trace replay <file.mst> [threads]"
+                         " | trace import <din|lackey|champsim> <file> [virtual]\n";
+        }
+        else if (in_path.empty() || !reader.open(in_path)) {
+            std::cout << "Invalid trace file\n";
+        }
+        else {
+            unsigned threads = 0;
+            std::stringstream(out_path) >> threads;
+            if (threads == 0)
+                threads = std::thread::hardware_concurrency();
+            if (threads == 0)
+                threads = 1;
+
+            ReplayCounts counts;
+            std::vector<std::vector<TraceRecord>> batch;
+            auto start = std::chrono::steady_clock::now();
+
+            //decode a few blocks per thread ahead, then apply them in order
+            for (std::size_t first = 0; first < reader.blocks(); first += 2 * threads) {
+                if (!reader.decode_blocks(first, 2 * threads, batch, threads)) {
+                    std::cout << "Corrupt trace block, replay stopped\n";
+                    break;
+                }
+                for (const auto &block : batch) {
+                    for (const TraceRecord &r : block)
+                        replay_record(r, counts);
+                }
+            }
+            replay_summary(counts, start);
+        }
+    }
+    //----
+    else if (cmd == "telemetry") {
+        std::string sub, path, format = "jsonl";
+        std::uint64_t every_events = 1000, every_ms = 1000;
+        ss >> sub;
+
+        if (sub == "start") {
+            ss >> path >> format >> every_events >> every_ms;
+            if (path.empty() || (format != "jsonl" && format != "prom")) {
+                std::cout << "Usage: telemetry start <file> <jsonl|prom> [every_events] [every_ms]\n";
+                return true;
+            }
+            TelemetryFormat fmt = (format == "prom") ? TelemetryFormat::PROMETHEUS
+                                                     : TelemetryFormat::JSONL;
+            if (telemetry_.start(path, fmt, every_events, every_ms))
+                std::cout << "Telemetry streaming to " << path << "\n";
+            else
+                std::cout << "Cannot open telemetry file " << path << "\n";
+        }
+        else if (sub == "stop") {
+            if (telemetry_.running()) {
+                telemetry_.publish(snapshot());
+                telemetry_.stop();
+            }
+            std::cout << "Telemetry stopped\n";
+        }
+        else {
+            std::cout << "Unknown telemetry command\n";
+        }
+    }
+    //----
+    else if (cmd == "perf") {
+        perf_report();
+    }
+    //----
+    else if (cmd == "bench") {
+        std::string what, option;
+        std::size_t count = 10000;
+        ss >> what >> count >> option;
+
+        if (what == "arena")
+            bench_arena(count, option == "huge");
+        else if (what == "trace")
+            bench_trace(count);
+        else if (what == "cache") {
+            //bench cache <cache_size> <block_size> <ways> [count]
+            std::size_t block_size = 0, ways = 0, accesses = 1000000;
+            std::stringstream args(option);
+            args >> block_size;
+            ss >> ways >> accesses;
+            bench_cache(count, block_size, ways, accesses);
+        }
+        else
+            std::cout << "Usage: bench arena <count> [huge] | bench trace <count>"
+                         " | bench cache <cache_size> <block_size> <ways> [count]\n";
+    }
+    //----
+    else {
+        std::cout << "Unknown command\n";
+    }
+    return true;
+}
@@ -0,0 +1,175 @@
+#include "telemetry.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+constexpr int FRESH = 4;
+
+double ratio(std::size_t part, std::size_t total) {
+    return (total == 0) ? 0.0 : (double)part / total;
+}
+}
+
+
+Telemetry::Telemetry()
+    : format_(TelemetryFormat::JSONL),
+      every_events_(1),
+      every_ms_(1000),
+      running_(false),
+      events_(0),
+      buffers_(),
+      back_(0),
+      front_(1),
+      middle_(2),
+      jsonl_(nullptr),
+      stop_requested_(false),
+      last_events_(0),
+      last_seconds_(0.0) {}
+
+Telemetry::~Telemetry() {
+    stop();
+}
+
+
+//Control
+bool Telemetry::start(const std::string &path, TelemetryFormat format,
+                      std::uint64_t every_events, std::uint64_t every_ms) {
+    stop();
+
+    if (format == TelemetryFormat::JSONL) {
+        jsonl_ = std::fopen(path.c_str(), "a");
+        if (!jsonl_)
+            return false;
+    } else {
+        std::FILE *f = std::fopen(path.c_str(), "w");
+        if (!f)
+            return false;
+        std::fclose(f);
+    }
+
+    path_ = path;
+    format_ = format;
+    every_events_ = every_events ? every_events : 1;
+    every_ms_ = every_ms ? every_ms : 1;
+    events_ = 0;
+    last_events_ = 0;
+    last_seconds_ = 0.0;
+    back_ = 0;
+    front_ = 1;
+    middle_.store(2);
+    stop_requested_.store(false);
+    running_ = true;
+
+    worker_ = std::thread(&Telemetry::run, this);
+    return true;
+}
+
+void Telemetry::stop() {
+    if (!running_)
+        return;
+
+    stop_requested_.store(true);
+    if (worker_.joinable())
+        worker_.join();
+
+    if (jsonl_) {
+        std::fclose(jsonl_);
+        jsonl_ = nullptr;
+    }
+    running_ = false;
+}
+
+
+//Triple buffer
+void Telemetry::publish(const TelemetrySnapshot &snapshot) {
+    if (!running_)
+        return;
+    buffers_[back_] = snapshot;
+    back_ = middle_.exchange(back_ | FRESH, std::memory_order_acq_rel) & 3;
+}
+
+bool Telemetry::take_latest(TelemetrySnapshot &out) {
+    if (!(middle_.load(std::memory_order_acquire) & FRESH))
+        return false;
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & 3;
+    out = buffers_[front_];
+    return true;
+}
+
+
+//Background thread
+void Telemetry::run() {
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+    auto next = start + std::chrono::milliseconds(every_ms_);
+
+    while (!stop_requested_.load()) {
+        //short naps keep stop() responsive for long intervals
+        auto now = Clock::now();
+        if (now < next) {
+            auto nap = std::min<Clock::duration>(next - now, std::chrono::milliseconds(10));
+            std::this_thread::sleep_for(nap);
+            continue;
+        }
+        next += std::chrono::milliseconds(every_ms_);
+
+        TelemetrySnapshot snapshot;
+        if (take_latest(snapshot))
+            emit(snapshot, std::chrono::duration<double>(Clock::now() - start).count());
+    }
+
+    TelemetrySnapshot snapshot;
+    if (take_latest(snapshot))
+        emit(snapshot, std::chrono::duration<double>(Clock::now() - start).count());
+}
+
+void Telemetry::emit(const TelemetrySnapshot &s, double seconds) {
+    double elapsed = seconds - last_seconds_;
+    double ops_per_sec = (elapsed > 0.0) ? (s.events - last_events_) / elapsed : 0.0;
+    last_events_ = s.events;
+    last_seconds_ = seconds;
+
+    double l1_hit_rate = ratio(s.l1_hits, s.l1_hits + s.l1_misses);
+    double l2_hit_rate = ratio(s.l2_hits, s.l2_hits + s.l2_misses);
+    double fault_rate = ratio(s.page_faults, s.page_hits + s.page_faults);
+    double alloc_failure_rate = ratio(s.failed_allocs, s.alloc_requests);
+
+    if (format_ == TelemetryFormat::JSONL) {
+        std::fprintf(jsonl_,
+                     "{\"time\":%.3f,\"events\":%llu,\"ops_per_sec\":%.1f,"
+                     "\"l1_hit_rate\":%.6f,\"l2_hit_rate\":%.6f,\"page_fault_rate\":%.6f,"
+                     "\"utilization\":%.6f,\"fragmentation\":%.6f,\"alloc_failure_rate\":%.6f}\n",
+                     seconds, (unsigned long long)s.events, ops_per_sec,
+                     l1_hit_rate, l2_hit_rate, fault_rate,
+                     s.utilization, s.fragmentation, alloc_failure_rate);
+        std::fflush(jsonl_);
+        return;
+    }
+
+    //rewrite then rename, so scrapers never see a half written file
+    std::string tmp = path_ + ".tmp";
+    std::FILE *f = std::fopen(tmp.c_str(), "w");
+    if (!f)
+        return;
+    std::fprintf(f,
+                 "# TYPE memsim_events_total counter\n"
+                 "memsim_events_total %llu\n"
+                 "# TYPE memsim_ops_per_second gauge\n"
+                 "memsim_ops_per_second %.1f\n"
+                 "# TYPE memsim_cache_hit_ratio gauge\n"
+                 "memsim_cache_hit_ratio{level=\"L1\"} %.6f\n"
+                 "memsim_cache_hit_ratio{level=\"L2\"} %.6f\n"
+                 "# TYPE memsim_page_fault_ratio gauge\n"
+                 "memsim_page_fault_ratio %.6f\n"
+                 "# TYPE memsim_memory_utilization gauge\n"
+                 "memsim_memory_utilization %.6f\n"
+                 "# TYPE memsim_external_fragmentation gauge\n"
+                 "memsim_external_fragmentation %.6f\n"
+                 "# TYPE memsim_alloc_failure_ratio gauge\n"
+                 "memsim_alloc_failure_ratio %.6f\n",
+                 (unsigned long long)s.events, ops_per_sec,
+                 l1_hit_rate, l2_hit_rate, fault_rate,
+                 s.utilization, s.fragmentation, alloc_failure_rate);
+    std::fclose(f);
+    std::rename(tmp.c_str(), path_.c_str());
+}
@@ -0,0 +1,561 @@
+#include "trace.h"
+#include "handle_table.h"
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+const char MAGIC[8] = {'M', 'E', 'M', 'S', 'I', 'M', 'T', 'R'};
+constexpr std::uint32_t VERSION = 2;
+constexpr std::size_t HEADER_BYTES = sizeof(MAGIC) + 4 + 4;
+constexpr std::size_t BLOCK_HEADER_BYTES = 4 + 4 + 8;
+constexpr std::size_t INDEX_ENTRY_BYTES = 8 + 4 + 8;
+constexpr unsigned char STREAM_CHANGE = 0x80;
+constexpr unsigned char OP_MASK = 0x0f;
+constexpr int TYPE_SHIFT = 4;
+constexpr unsigned char TYPE_MASK = 0x03;
+
+std::uint64_t zigzag(std::int64_t v) {
+    return (static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t v) {
+    return static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1);
+}
+
+//Address slot of an op: physical and virtual addresses are separate delta streams
+int address_slot(TraceOp op) {
+    return (op == TraceOp::VACCESS) ? 1 : 0;
+}
+
+bool get_varint(const unsigned char *&p, const unsigned char *end, std::uint64_t &value) {
+    //fast path: one byte values (small deltas, sizes, free distances)
+    if (p < end && *p < 0x80) {
+        value = *p++;
+        return true;
+    }
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (p >= end)
+            return false;
+        unsigned char byte = *p++;
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if (byte < 0x80)
+            return true;
+    }
+    return false;
+}
+
+template <typename T>
+T load_pod(const unsigned char *p) {
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return value;
+}
+}
+
+
+//Writer
+
+TraceWriter::TraceWriter()
+    : file_(nullptr),
+      failed_(false),
+      block_records_(4096),
+      offset_(0),
+      records_(0),
+      mallocs_(0),
+      block_count_(0),
+      block_first_malloc_(0),
+      stream_(0),
+      current_(nullptr) {}
+
+TraceWriter::~TraceWriter() {
+    if (file_)
+        close();
+}
+
+bool TraceWriter::open(const std::string &path, std::uint32_t block_records) {
+    if (file_)
+        close();
+
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_)
+        return false;
+
+    failed_ = false;
+    block_records_ = (block_records > 0) ? block_records : 4096;
+    offset_ = 0;
+    records_ = 0;
+    mallocs_ = 0;
+    index_.clear();
+
+    write(MAGIC, sizeof(MAGIC));
+    write(&VERSION, sizeof(VERSION));
+    write(&block_records_, sizeof(block_records_));
+
+    payload_.clear();
+    payload_.reserve(block_records_ * 3);
+    block_count_ = 0;
+    block_first_malloc_ = 0;
+    stream_ = 0;
+    last_.clear();
+    current_ = &last_[0];
+    return !failed_;
+}
+
+void TraceWriter::write(const void *data, std::size_t size) {
+    if (!failed_ && std::fwrite(data, 1, size, file_) != size)
+        failed_ = true;
+    offset_ += size;
+}
+
+void TraceWriter::put_varint(std::uint64_t value) {
+    while (value >= 0x80) {
+        payload_.push_back(static_cast<unsigned char>(value | 0x80));
+        value >>= 7;
+    }
+    payload_.push_back(static_cast<unsigned char>(value));
+}
+
+void TraceWriter::append(const TraceRecord &record) {
+    unsigned char tag = (static_cast<unsigned char>(record.op) & OP_MASK) |
+                        ((static_cast<unsigned char>(record.type) & TYPE_MASK) << TYPE_SHIFT);
+    bool stream_change = record.stream != stream_;
+    if (stream_change) {
+        tag |= STREAM_CHANGE;
+        stream_ = record.stream;
+        current_ = &last_[stream_];
+    }
+
+    payload_.push_back(tag);
+    if (stream_change)
+        put_varint(stream_);
+
+    switch (record.op) {
+        case TraceOp::MALLOC:
+            put_varint(record.value);
+            mallocs_++;
+            break;
+        case TraceOp::MALLOC_ALIGNED: {
+            std::uint64_t shift = 0;
+            while (shift < 63 && (std::uint64_t(1) << shift) < record.arg)
+                shift++;
+            put_varint(record.value);
+            put_varint(shift);
+            mallocs_++;
+            break;
+        }
+        case TraceOp::FREE:
+        case TraceOp::REALLOC:
+            //distance back from the latest MALLOC
+            put_varint(zigzag(static_cast<std::int64_t>(mallocs_ - 1 - record.value)));
+            if (record.op == TraceOp::REALLOC)
+                put_varint(record.arg);
+            break;
+        case TraceOp::BATCH:
+            put_varint(record.value);
+            break;
+        case TraceOp::ACCESS:
+        case TraceOp::VACCESS: {
+            std::uint64_t &last = (*current_)[address_slot(record.op)];
+            put_varint(zigzag(static_cast<std::int64_t>(record.value - last)));
+            last = record.value;
+            break;
+        }
+    }
+
+    records_++;
+    if (++block_count_ == block_records_)
+        flush_block();
+}
+
+void TraceWriter::flush_block() {
+    if (block_count_ > 0) {
+        index_.push_back({offset_, block_count_, block_first_malloc_});
+
+        std::uint32_t payload_bytes = static_cast<std::uint32_t>(payload_.size());
+        write(&block_count_, sizeof(block_count_));
+        write(&payload_bytes, sizeof(payload_bytes));
+        write(&block_first_malloc_, sizeof(block_first_malloc_));
+        write(payload_.data(), payload_.size());
+    }
+
+    //every block starts from a clean delta state
+    payload_.clear();
+    block_count_ = 0;
+    block_first_malloc_ = mallocs_;
+    stream_ = 0;
+    last_.clear();
+    current_ = &last_[0];
+}
+
+bool TraceWriter::close() {
+    if (!file_)
+        return false;
+
+    flush_block();
+
+    std::uint64_t index_offset = offset_;
+    std::uint64_t count = index_.size();
+    write(&count, sizeof(count));
+    for (const auto &block : index_) {
+        write(&block.offset, sizeof(block.offset));
+        write(&block.records, sizeof(block.records));
+        write(&block.first_malloc, sizeof(block.first_malloc));
+    }
+    write(&index_offset, sizeof(index_offset));
+
+    bool ok = (std::fclose(file_) == 0) && !failed_;
+    file_ = nullptr;
+    return ok;
+}
+
+
+//Reader
+
+TraceReader::TraceReader()
+    : data_(nullptr),
+      size_(0),
+      mapped_(false),
+      records_(0) {}
+
+TraceReader::~TraceReader() {
+    close();
+}
+
+bool TraceReader::open(const std::string &path) {
+    close();
+
+#ifdef __linux__
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+        return false;
+
+    //replay walks the blocks front to back
+    madvise(p, st.st_size, MADV_SEQUENTIAL);
+    data_ = static_cast<const unsigned char *>(p);
+    size_ = static_cast<std::size_t>(st.st_size);
+    mapped_ = true;
+#else
+    std::FILE *f = std::fopen(path.c_str(), "rb");
+    if (!f)
+        return false;
+    std::fseek(f, 0, SEEK_END);
+    long len = std::ftell(f);
+    std::fseek(f, 0, SEEK_SET);
+    if (len <= 0) {
+        std::fclose(f);
+        return false;
+    }
+    unsigned char *copy = new unsigned char[len];
+    std::size_t got = std::fread(copy, 1, len, f);
+    std::fclose(f);
+    data_ = copy;
+    size_ = got;
+#endif
+
+    //header (version 1 traces are read as is, they lack only the newer ops)
+    if (size_ < HEADER_BYTES + 16 || std::memcmp(data_, MAGIC, sizeof(MAGIC)) != 0 ||
+        load_pod<std::uint32_t>(data_ + sizeof(MAGIC)) == 0 ||
+        load_pod<std::uint32_t>(data_ + sizeof(MAGIC)) > VERSION) {
+        close();
+        return false;
+    }
+
+    //index
+    std::uint64_t index_offset = load_pod<std::uint64_t>(data_ + size_ - 8);
+    if (index_offset < HEADER_BYTES || index_offset > size_ - 16) {
+        close();
+        return false;
+    }
+    std::uint64_t count = load_pod<std::uint64_t>(data_ + index_offset);
+    if (count > (size_ - 16 - index_offset) / INDEX_ENTRY_BYTES) {
+        close();
+        return false;
+    }
+
+    const unsigned char *entry = data_ + index_offset + 8;
+    for (std::uint64_t i = 0; i < count; i++, entry += INDEX_ENTRY_BYTES) {
+        BlockInfo block;
+        block.offset = load_pod<std::uint64_t>(entry);
+        block.records = load_pod<std::uint32_t>(entry + 8);
+        block.first_malloc = load_pod<std::uint64_t>(entry + 12);
+        if (block.offset < HEADER_BYTES || block.offset + BLOCK_HEADER_BYTES > index_offset) {
+            close();
+            return false;
+        }
+        index_.push_back(block);
+        records_ += block.records;
+    }
+    return true;
+}
+
+void TraceReader::close() {
+    if (data_) {
+#ifdef __linux__
+        if (mapped_)
+            munmap(const_cast<unsigned char *>(data_), size_);
+#else
+        delete[] data_;
+#endif
+    }
+    data_ = nullptr;
+    size_ = 0;
+    mapped_ = false;
+    records_ = 0;
+    index_.clear();
+}
+
+bool TraceReader::decode_block(std::size_t block, std::vector<TraceRecord> &out) const {
+    out.clear();
+    if (block >= index_.size())
+        return false;
+
+    const BlockInfo &info = index_[block];
+    const unsigned char *p = data_ + info.offset;
+    std::uint32_t count = load_pod<std::uint32_t>(p);
+    std::uint32_t payload_bytes = load_pod<std::uint32_t>(p + 4);
+    std::uint64_t mallocs = load_pod<std::uint64_t>(p + 8);
+    p += BLOCK_HEADER_BYTES;
+    if (count != info.records || payload_bytes > size_ - (p - data_))
+        return false;
+
+    const unsigned char *end = p + payload_bytes;
+    std::uint32_t stream = 0;
+    std::unordered_map<std::uint32_t, std::array<std::uint64_t, 2>> last;
+    std::array<std::uint64_t, 2> *current = &last[0];
+    out.resize(count);
+
+    for (std::uint32_t i = 0; i < count; i++) {
+        if (p >= end)
+            return false;
+        unsigned char tag = *p++;
+        std::uint64_t value = 0;
+
+        if (tag & STREAM_CHANGE) {
+            if (!get_varint(p, end, value))
+                return false;
+            stream = static_cast<std::uint32_t>(value);
+            current = &last[stream];
+        }
+
+        TraceRecord &record = out[i];
+        record.op = static_cast<TraceOp>(tag & OP_MASK);
+        record.type = static_cast<AccessType>((tag >> TYPE_SHIFT) & TYPE_MASK);
+        if (record.type > AccessType::IFETCH)
+            return false;
+        record.stream = stream;
+        record.arg = 0;
+        if (!get_varint(p, end, value))
+            return false;
+
+        switch (record.op) {
+            case TraceOp::MALLOC:
+                record.value = value;
+                mallocs++;
+                break;
+            case TraceOp::MALLOC_ALIGNED:
+                record.value = value;
+                if (!get_varint(p, end, value) || value > 63)
+                    return false;
+                record.arg = std::uint64_t(1) << value;
+                mallocs++;
+                break;
+            case TraceOp::FREE:
+            case TraceOp::REALLOC:
+                record.value = mallocs - 1 - static_cast<std::uint64_t>(unzigzag(value));
+                if (record.op == TraceOp::REALLOC && !get_varint(p, end, record.arg))
+                    return false;
+                break;
+            case TraceOp::BATCH:
+                record.value = value;
+                break;
+            case TraceOp::ACCESS:
+            case TraceOp::VACCESS: {
+                std::uint64_t &prev = (*current)[address_slot(record.op)];
+                prev += static_cast<std::uint64_t>(unzigzag(value));
+                record.value = prev;
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+bool TraceReader::decode_blocks(std::size_t first, std::size_t count,
+                                std::vector<std::vector<TraceRecord>> &out, unsigned threads) const {
+    if (first > index_.size())
+        return false;
+    if (count > index_.size() - first)
+        count = index_.size() - first;
+    out.resize(count);
+
+    if (threads <= 1 || count <= 1) {
+        for (std::size_t i = 0; i < count; i++) {
+            if (!decode_block(first + i, out[i]))
+                return false;
+        }
+        return true;
+    }
+
+    //blocks are independent, hand them out round robin
+    std::atomic<bool> ok(true);
+    std::vector<std::thread> workers;
+    unsigned n = (count < threads) ? static_cast<unsigned>(count) : threads;
+    for (unsigned t = 0; t < n; t++) {
+        workers.emplace_back([&, t]() {
+            for (std::size_t i = t; i < count && ok; i += n) {
+                if (!decode_block(first + i, out[i]))
+                    ok = false;
+            }
+        });
+    }
+    for (auto &worker : workers)
+        worker.join();
+    return ok;
+}
+
+
+//Text converter
+bool trace_convert_text(const std::string &in_path, const std::string &out_path) {
+    std::ifstream in(in_path);
+    if (!in)
+        return false;
+
+    TraceWriter out;
+    if (!out.open(out_path))
+        return false;
+
+    //mirrors the allocators' id assignment: text id -> MALLOC ordinal
+    HandleTable<std::uint64_t> ids;
+    std::uint64_t mallocs = 0, ignored = 0, bad_frees = 0;
+    std::uint32_t stream = 0;
+    std::string line;
+
+    while (std::getline(in, line)) {
+        std::stringstream ss(line);
+        std::string cmd;
+        std::uint64_t arg = 0;
+        ss >> cmd;
+
+        if (!(ss >> arg)) {
+            if (!cmd.empty())
+                ignored++;
+            continue;
+        }
+
+        if (cmd == "malloc") {
+            ids.insert(mallocs);
+            out.append({TraceOp::MALLOC, stream, arg});
+            mallocs++;
+        }
+        else if (cmd == "malloc_aligned") {
+            std::uint64_t alignment = 0;
+            if (!(ss >> alignment) || alignment == 0 || (alignment & (alignment - 1)) != 0) {
+                ignored++;
+                continue;
+            }
+            ids.insert(mallocs);
+            out.append({TraceOp::MALLOC_ALIGNED, stream, arg, AccessType::READ, alignment});
+            mallocs++;
+        }
+        else if (cmd == "realloc") {
+            std::uint64_t size = 0;
+            const std::uint64_t *ordinal = ids.find(arg);
+            if (!(ss >> size)) {
+                ignored++;
+                continue;
+            }
+            if (!ordinal) {
+                bad_frees++;
+                continue;
+            }
+            out.append({TraceOp::REALLOC, stream, *ordinal, AccessType::READ, size});
+        }
+        else if (cmd == "malloc_batch") {
+            std::vector<std::uint64_t> sizes{arg};
+            while (ss >> arg)
+                sizes.push_back(arg);
+            out.append({TraceOp::BATCH, stream, sizes.size()});
+            for (std::uint64_t size : sizes) {
+                ids.insert(mallocs);
+                out.append({TraceOp::MALLOC, stream, size});
+                mallocs++;
+            }
+        }
+        else if (cmd == "free_batch") {
+            std::vector<std::uint64_t> ordinals;
+            do {
+                const std::uint64_t *ordinal = ids.find(arg);
+                if (!ordinal) {
+                    bad_frees++;
+                    continue;
+                }
+                ordinals.push_back(*ordinal);
+                ids.erase(arg);
+            } while (ss >> arg);
+            if (ordinals.empty())
+                continue;
+            out.append({TraceOp::BATCH, stream, ordinals.size()});
+            for (std::uint64_t ordinal : ordinals)
+                out.append({TraceOp::FREE, stream, ordinal});
+        }
+        else if (cmd == "free") {
+            const std::uint64_t *ordinal = ids.find(arg);
+            if (!ordinal) {
+                bad_frees++;
+                continue;
+            }
+            out.append({TraceOp::FREE, stream, *ordinal});
+            ids.erase(arg);
+        }
+        else if (cmd == "access") {
+            out.append({TraceOp::ACCESS, stream, arg});
+        }
+        else if (cmd == "vaccess") {
+            out.append({TraceOp::VACCESS, stream, arg});
+        }
+        else if (cmd == "stream") {
+            stream = static_cast<std::uint32_t>(arg);
+        }
+        else {
+            ignored++;
+        }
+    }
+
+    std::uint64_t records = out.records();
+    if (!out.close())
+        return false;
+
+    std::cout << "Converted " << records << " records to " << out_path
+              << " (" << out.bytes() << " bytes, "
+              << (records ? (double)out.bytes() / records : 0.0) << " bytes/record)\n";
+    if (ignored > 0)
+        std::cout << "Ignored " << ignored << " non-trace lines\n";
+    if (bad_frees > 0)
+        std::cout << "Dropped " << bad_frees << " frees or reallocs of unknown ids\n";
+    return true;
+}
@@ -0,0 +1,215 @@
+#include "trace_import.h"
+#include <cstring>
+
+namespace {
+constexpr std::size_t BUFFER_BYTES = std::size_t(1) << 20;
+constexpr std::size_t CHAMPSIM_RECORD = 64;
+
+int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+const char *skip_spaces(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    return p;
+}
+
+//Parse a hex number with optional 0x prefix, false if there are no digits
+bool parse_hex(const char *&p, const char *end, std::uint64_t &value) {
+    if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+        p += 2;
+    const char *start = p;
+    value = 0;
+    int d;
+    while (p < end && (d = hex_digit(*p)) >= 0) {
+        value = (value << 4) | static_cast<std::uint64_t>(d);
+        p++;
+    }
+    return p != start;
+}
+}
+
+
+TraceImporter::TraceImporter()
+    : file_(nullptr),
+      format_(ImportFormat::DINERO),
+      op_(TraceOp::ACCESS),
+      begin_(0),
+      end_(0),
+      eof_(false),
+      references_(0),
+      skipped_(0) {}
+
+TraceImporter::~TraceImporter() {
+    close();
+}
+
+bool TraceImporter::open(const std::string &path, ImportFormat format, bool is_virtual) {
+    close();
+    file_ = std::fopen(path.c_str(), "rb");
+    if (!file_)
+        return false;
+
+    format_ = format;
+    op_ = is_virtual ? TraceOp::VACCESS : TraceOp::ACCESS;
+    buffer_.resize(BUFFER_BYTES);
+    begin_ = end_ = 0;
+    eof_ = false;
+    references_ = 0;
+    skipped_ = 0;
+    return true;
+}
+
+void TraceImporter::close() {
+    if (file_)
+        std::fclose(file_);
+    file_ = nullptr;
+}
+
+//Move the unread tail to the front and read more, false if nothing was added
+bool TraceImporter::fill() {
+    if (eof_ || !file_)
+        return false;
+    if (begin_ > 0) {
+        std::memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+        end_ -= begin_;
+        begin_ = 0;
+    }
+    std::size_t got = std::fread(buffer_.data() + end_, 1, buffer_.size() - end_, file_);
+    if (got == 0) {
+        eof_ = true;
+        return false;
+    }
+    end_ += got;
+    return true;
+}
+
+bool TraceImporter::next_line(const char *&begin, const char *&end) {
+    for (;;) {
+        const char *start = buffer_.data() + begin_;
+        const char *nl = static_cast<const char *>(std::memchr(start, '\n', end_ - begin_));
+        if (nl) {
+            begin = start;
+            end = nl;
+            begin_ = (nl - buffer_.data()) + 1;
+            return true;
+        }
+        //a line longer than the whole buffer is cut, the rest parses as junk
+        bool full = begin_ == 0 && end_ == buffer_.size();
+        if (full || !fill()) {
+            if (begin_ == end_)
+                return false;
+            begin = buffer_.data() + begin_;
+            end = buffer_.data() + end_;
+            begin_ = end_;
+            return true;
+        }
+    }
+}
+
+void TraceImporter::emit(std::uint64_t address, AccessType type, std::vector<TraceRecord> &out) {
+    out.push_back({op_, 0, address, type});
+    references_++;
+}
+
+void TraceImporter::parse_dinero(const char *p, const char *end, std::vector<TraceRecord> &out) {
+    p = skip_spaces(p, end);
+    if (p == end || *p == '\r')
+        return;
+
+    int label = (*p >= '0' && *p <= '9') ? *p - '0' : -1;
+    std::uint64_t address = 0;
+    p++;
+    bool separated = p < end && (*p == ' ' || *p == '\t');
+    p = skip_spaces(p, end);
+
+    if (label < 0 || label > 2 || !separated || !parse_hex(p, end, address)) {
+        skipped_++;
+        return;
+    }
+    emit(address, static_cast<AccessType>(label), out);
+}
+
+void TraceImporter::parse_lackey(const char *p, const char *end, std::vector<TraceRecord> &out) {
+    //valgrind banner lines
+    if (end - p >= 2 && p[0] == '=' && p[1] == '=')
+        return;
+    p = skip_spaces(p, end);
+    if (p == end || *p == '\r')
+        return;
+
+    char kind = *p++;
+    std::uint64_t address = 0;
+    p = skip_spaces(p, end);
+    if (!parse_hex(p, end, address)) {
+        skipped_++;
+        return;
+    }
+
+    switch (kind) {
+        case 'I': emit(address, AccessType::IFETCH, out); break;
+        case 'L': emit(address, AccessType::READ, out); break;
+        case 'S': emit(address, AccessType::WRITE, out); break;
+        case 'M':
+            emit(address, AccessType::READ, out);
+            emit(address, AccessType::WRITE, out);
+            break;
+        default:
+            skipped_++;
+    }
+}
+
+void TraceImporter::parse_champsim(const unsigned char *record, std::vector<TraceRecord> &out) {
+    std::uint64_t ip, dst[2], src[4];
+    std::memcpy(&ip, record, 8);
+    std::memcpy(dst, record + 16, sizeof(dst));
+    std::memcpy(src, record + 32, sizeof(src));
+
+    if (ip)
+        emit(ip, AccessType::IFETCH, out);
+    for (std::uint64_t address : src) {
+        if (address)
+            emit(address, AccessType::READ, out);
+    }
+    for (std::uint64_t address : dst) {
+        if (address)
+            emit(address, AccessType::WRITE, out);
+    }
+}
+
+bool TraceImporter::next(std::vector<TraceRecord> &out, std::size_t max) {
+    out.clear();
+    if (!file_)
+        return false;
+
+    while (out.size() < max) {
+        if (format_ == ImportFormat::CHAMPSIM) {
+            if (end_ - begin_ < CHAMPSIM_RECORD && !fill()) {
+                //trailing partial record
+                if (begin_ != end_) {
+                    skipped_++;
+                    begin_ = end_;
+                }
+                break;
+            }
+            if (end_ - begin_ < CHAMPSIM_RECORD)
+                continue;
+            parse_champsim(reinterpret_cast<const unsigned char *>(buffer_.data() + begin_), out);
+            begin_ += CHAMPSIM_RECORD;
+            continue;
+        }
+
+        const char *line, *line_end;
+        if (!next_line(line, line_end))
+            break;
+        if (format_ == ImportFormat::DINERO)
+            parse_dinero(line, line_end, out);
+        else
+            parse_lackey(line, line_end, out);
+    }
+    return !out.empty();
+}
@@ -1,4 +1,5 @@
 #include "virtual_memory.h"
+#include "perf_counters.h"
 #include <iostream>
 #include <cmath>
 
@@ -7,9 +8,12 @@ VirtualMemory::VirtualMemory()
     : page_size_(0),
       num_pages_(0),
       offset_bits_(0),
+      frames_(nullptr),
       page_hits_(0),
       page_faults_(0),
-      page_evictions_(0) {}
+      page_evictions_(0),
+      frame_failures_(0),
+      last_fault_(false) {}
 
 
 //Helpers
@@ -33,54 +37,143 @@ bool VirtualMemory::init(std::size_t page_size, std::size_t num_pages) {
         return false;
     }
 
+    release_all();
+    //tracking is sized for the old address space
+    tracker_.stop();
+
     page_size_ = page_size;
     num_pages_ = num_pages;
     offset_bits_ = static_cast<std::size_t>(std::log2(page_size_));
 
-    resident_pages_.clear();
-    while (!fifo_queue_.empty()) fifo_queue_.pop();
-
     page_hits_ = 0;
     page_faults_ = 0;
     page_evictions_ = 0;
+    frame_failures_ = 0;
 
     return true;
 }
 
+void VirtualMemory::set_frame_provider(FrameProvider *provider) {
+    release_all();
+    frames_ = provider;
+}
+
 
 //Access
 std::size_t VirtualMemory::access(std::size_t virtual_address) {
+    PERF_SCOPE(VM_ACCESS);
+    return translate(virtual_address, true);
+}
+
+std::size_t VirtualMemory::warm(std::size_t virtual_address) {
+    return translate(virtual_address, false);
+}
+
+std::size_t VirtualMemory::translate(std::size_t virtual_address, bool record) {
     std::size_t page_number = extract_page_number(virtual_address);
     std::size_t offset = extract_offset(virtual_address);
+    last_fault_ = false;
 
     //Bounds check 
     if (page_number >= num_pages_) {
-        std::cout << "Invalid virtual address\n";
+        if (record)
+            std::cout << "Invalid virtual address\n";
         return 0;
     }
+    tracker_.reference(page_number);
 
     //PAGE HIT
-    if (resident_pages_.count(page_number)) {
-        page_hits_++;
-        return page_number * page_size_ + offset;
+    auto it = page_table_.find(page_number);
+    std::size_t base = 0;
+    if (it != page_table_.end()) {
+        if (frame_base(page_number, it->second, base)) {
+            if (record) page_hits_++;
+            return base + offset;
+        }
+        //the frame was released behind the VM's back, fault the page in again
+        if (record)
+            std::cout << "Page frame lost, faulting page " << page_number << " in again\n";
+        forget(page_number);
     }
 
     //PAGE FAULT
-    page_faults_++;
+    if (record) page_faults_++;
+    last_fault_ = true;
 
     //Evict if memory full
-    if (resident_pages_.size() >= num_pages_) {
-        std::size_t victim = fifo_queue_.front();
-        fifo_queue_.pop();
-        resident_pages_.erase(victim);
-        page_evictions_++;
+    if (page_table_.size() >= num_pages_)
+        evict_one(record);
+
+    //Allocate a frame, evicting under memory pressure
+    AllocId frame = INVALID_ID;
+    if (frames_) {
+        frame = frames_->allocate_frame(page_size_, page_number);
+        while (frame == INVALID_ID && !fifo_queue_.empty()) {
+            evict_one(record);
+            frame = frames_->allocate_frame(page_size_, page_number);
+        }
+        if (frame == INVALID_ID) {
+            if (record) {
+                frame_failures_++;
+                std::cout << "Out of physical memory\n";
+            }
+            return 0;
+        }
     }
 
     //Page in
-    resident_pages_.insert(page_number);
+    page_table_[page_number] = frame;
     fifo_queue_.push(page_number);
+    if (frame != INVALID_ID)
+        held_frames_.insert(frame);
 
-    return page_number * page_size_ + offset;
+    frame_base(page_number, frame, base);
+    return base + offset;
+}
+
+bool VirtualMemory::frame_base(std::size_t page_number, AllocId frame, std::size_t &address) const {
+    if (frames_)
+        return frames_->frame_address(frame, address);
+    address = page_number * page_size_;
+    return true;
+}
+
+void VirtualMemory::evict_one(bool record) {
+    std::size_t victim = fifo_queue_.front();
+    fifo_queue_.pop();
+
+    auto it = page_table_.find(victim);
+    if (frames_ && it->second != INVALID_ID)
+        frames_->release_frame(it->second);
+    held_frames_.erase(it->second);
+    page_table_.erase(it);
+
+    if (record) page_evictions_++;
+}
+
+void VirtualMemory::forget(std::size_t page_number) {
+    auto it = page_table_.find(page_number);
+    held_frames_.erase(it->second);
+    page_table_.erase(it);
+
+    std::queue<std::size_t> kept;
+    for (; !fifo_queue_.empty(); fifo_queue_.pop()) {
+        if (fifo_queue_.front() != page_number)
+            kept.push(fifo_queue_.front());
+    }
+    fifo_queue_.swap(kept);
+}
+
+void VirtualMemory::release_all() {
+    if (frames_) {
+        for (const auto &entry : page_table_) {
+            if (entry.second != INVALID_ID)
+                frames_->release_frame(entry.second);
+        }
+    }
+    page_table_.clear();
+    held_frames_.clear();
+    while (!fifo_queue_.empty()) fifo_queue_.pop();
 }
 
 
@@ -90,14 +183,88 @@ void VirtualMemory::stats() const {
     std::cout << "Page hits: " << page_hits_ << "\n";
     std::cout << "Page faults: " << page_faults_ << "\n";
     std::cout << "Page evictions: " << page_evictions_ << "\n";
+    std::cout << "Resident pages: " << page_table_.size() << "\n";
+    std::cout << "Page frames: " << (frames_ ? "allocated from physical memory" : "identity mapped") << "\n";
+    if (frame_failures_ > 0)
+        std::cout << "Frame allocation failures: " << frame_failures_ << "\n";
 }
 
 
 //Reset
 void VirtualMemory::reset() {
-    resident_pages_.clear();
-    while (!fifo_queue_.empty()) fifo_queue_.pop();
+    release_all();
     page_hits_ = 0;
     page_faults_ = 0;
     page_evictions_ = 0;
-}
\ No newline at end of file
+    frame_failures_ = 0;
+    tracker_.clear();
+}
+
+bool VirtualMemory::start_tracking(TrackMode mode, std::size_t window, std::size_t scan_interval) {
+    if (num_pages_ == 0)
+        return false;
+    return tracker_.start(mode, num_pages_, window, scan_interval);
+}
+
+
+//Checkpoint
+//Frame ids are only meaningful together with the allocator state saved
+//in the same checkpoint; the provider itself is re-attached by the caller.
+void VirtualMemory::save(CheckpointWriter &out) const {
+    out.begin_section(CheckpointSection::VIRTUAL);
+    out.put(page_size_);
+    out.put(num_pages_);
+    out.put(page_hits_);
+    out.put(page_faults_);
+    out.put(page_evictions_);
+    out.put(frame_failures_);
+
+    //the FIFO queue holds exactly the resident pages, oldest first
+    std::queue<std::size_t> order = fifo_queue_;
+    out.put(static_cast<std::uint64_t>(order.size()));
+    while (!order.empty()) {
+        out.put(order.front());
+        out.put(page_table_.at(order.front()));
+        order.pop();
+    }
+    tracker_.save(out);
+}
+
+bool VirtualMemory::load(CheckpointReader &in, FrameProvider *provider) {
+    if (!in.expect_section(CheckpointSection::VIRTUAL))
+        return false;
+
+    std::size_t page_size = 0, num_pages = 0;
+    std::size_t hits = 0, faults = 0, evictions = 0, failures = 0;
+    std::uint64_t count = 0;
+    in.get(page_size);
+    in.get(num_pages);
+    in.get(hits);
+    in.get(faults);
+    in.get(evictions);
+    in.get(failures);
+    //start detached so init does not release frames of the current state
+    frames_ = nullptr;
+    if (!in.get(count) || !init(page_size, num_pages))
+        return false;
+
+    for (std::uint64_t i = 0; i < count; i++) {
+        std::size_t page = 0;
+        AllocId frame = INVALID_ID;
+        if (!in.get(page) || !in.get(frame))
+            return false;
+        page_table_[page] = frame;
+        fifo_queue_.push(page);
+        if (frame != INVALID_ID)
+            held_frames_.insert(frame);
+    }
+    if (!tracker_.load(in))
+        return false;
+
+    frames_ = provider;
+    page_hits_ = hits;
+    page_faults_ = faults;
+    page_evictions_ = evictions;
+    frame_failures_ = failures;
+    return true;
+}
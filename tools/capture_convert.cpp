@@ -0,0 +1,184 @@
+#include "malloc_capture.h"
+#include "trace.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+/*
+Capture to trace converter
+    memsim_capture_convert app.cap app.mst
+
+- Chunks of all threads are merged back into sequence order
+- Every successful allocation becomes a MALLOC; its trace ordinal is the
+  stable id later FREE records refer to
+- Threads become trace streams
+- realloc of a live block becomes REALLOC (the block keeps its ordinal,
+  the allocator decides whether it grows in place or moves); realloc(NULL)
+  is a MALLOC and realloc(p, 0) that frees p is a FREE
+- The old block of a realloc is released at its REALLOC_RELEASE event, the
+  REALLOC record goes out at the REALLOC event that names the new pointer
+- posix_memalign becomes MALLOC_ALIGNED
+- Frees of blocks allocated before the capture started are dropped
+*/
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        std::cout << "Usage: memsim_capture_convert <capture> <out.mst>\n";
+        return 1;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+        std::cout << "Cannot open capture " << argv[1] << "\n";
+        return 1;
+    }
+
+    std::vector<CaptureEvent> events;
+    std::vector<std::uint32_t> threads;
+    CaptureChunkHeader header;
+    while (in.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+        if (header.magic != CAPTURE_MAGIC || header.count > CAPTURE_CHUNK_EVENTS) {
+            std::cout << "Corrupt capture chunk, stopping\n";
+            break;
+        }
+        std::size_t first = events.size();
+        events.resize(first + header.count);
+        if (!in.read(reinterpret_cast<char *>(&events[first]), header.count * sizeof(CaptureEvent))) {
+            std::cout << "Truncated capture chunk, stopping\n";
+            events.resize(first);
+            break;
+        }
+        threads.resize(events.size(), header.thread);
+    }
+
+    //restore the global order, keeping each event's thread
+    std::vector<std::size_t> order(events.size());
+    for (std::size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+        return events[a].seq < events[b].seq;
+    });
+
+    TraceWriter out;
+    if (!out.open(argv[2])) {
+        std::cout << "Cannot write " << argv[2] << "\n";
+        return 1;
+    }
+
+    //live pointer -> MALLOC ordinal
+    std::unordered_map<std::uint64_t, std::uint64_t> live;
+    std::uint64_t mallocs = 0, unknown_frees = 0, aliased = 0;
+
+    //realloc in flight per thread: old pointer -> ordinal, between its two events
+    struct Pending {
+        std::uint64_t old_ptr;
+        std::uint64_t ordinal;
+        bool known;
+    };
+    std::unordered_map<std::uint32_t, Pending> pending;
+
+    auto emit_free = [&](std::uint32_t stream, std::uint64_t ptr) {
+        auto it = live.find(ptr);
+        if (it == live.end()) {
+            unknown_frees++;
+            return;
+        }
+        out.append({TraceOp::FREE, stream, it->second});
+        live.erase(it);
+    };
+    auto emit_malloc = [&](std::uint32_t stream, std::uint64_t ptr, std::uint64_t size, std::uint64_t alignment) {
+        //an address that is still live lost its free (e.g. a thread not flushed
+        //at exit): the old block stays allocated, later frees go to the new one
+        auto it = live.find(ptr);
+        if (it != live.end()) {
+            aliased++;
+            it->second = mallocs++;
+        } else {
+            live.emplace(ptr, mallocs++);
+        }
+        if (alignment > 1)
+            out.append({TraceOp::MALLOC_ALIGNED, stream, size, AccessType::READ, alignment});
+        else
+            out.append({TraceOp::MALLOC, stream, size});
+    };
+    //first half of a realloc: the old address may be reused from here on
+    auto release_for_realloc = [&](std::uint32_t stream, std::uint64_t old_ptr) {
+        Pending p{old_ptr, 0, false};
+        auto it = live.find(old_ptr);
+        if (it != live.end()) {
+            p.ordinal = it->second;
+            p.known = true;
+            live.erase(it);
+        }
+        pending[stream] = p;
+    };
+    auto emit_realloc = [&](std::uint32_t stream, std::uint64_t old_ptr, std::uint64_t ptr, std::uint64_t size) {
+        auto pit = pending.find(stream);
+        if (pit == pending.end() || pit->second.old_ptr != old_ptr) {
+            //no release event (capture of an older shim): release here
+            release_for_realloc(stream, old_ptr);
+            pit = pending.find(stream);
+        }
+        Pending p = pit->second;
+        pending.erase(pit);
+        if (!p.known) {
+            //resizing a block from before the capture: only the new one is known
+            unknown_frees++;
+            emit_malloc(stream, ptr, size, 1);
+            return;
+        }
+        auto it = live.find(ptr);
+        if (it != live.end()) {
+            aliased++;
+            live.erase(it);
+        }
+        live.emplace(ptr, p.ordinal);
+        out.append({TraceOp::REALLOC, stream, p.ordinal, AccessType::READ, size});
+    };
+
+    for (std::size_t i : order) {
+        const CaptureEvent &e = events[i];
+        std::uint32_t stream = threads[i];
+
+        switch (static_cast<CaptureOp>(e.op)) {
+            case CaptureOp::MALLOC:
+            case CaptureOp::CALLOC:
+                emit_malloc(stream, e.ptr, e.size, 1);
+                break;
+            case CaptureOp::MEMALIGN:
+                emit_malloc(stream, e.ptr, e.size, e.aux);
+                break;
+            case CaptureOp::FREE:
+                emit_free(stream, e.ptr);
+                break;
+            case CaptureOp::REALLOC_RELEASE:
+                release_for_realloc(stream, e.ptr);
+                break;
+            case CaptureOp::REALLOC:
+                if (e.aux && e.ptr)
+                    emit_realloc(stream, e.aux, e.ptr, e.size);
+                else if (e.aux)
+                    emit_free(stream, e.aux);
+                else if (e.ptr)
+                    emit_malloc(stream, e.ptr, e.size, 1);
+                break;
+        }
+    }
+
+    std::uint64_t records = out.records();
+    if (!out.close()) {
+        std::cout << "Cannot write " << argv[2] << "\n";
+        return 1;
+    }
+
+    std::cout << "Converted " << events.size() << " events from " << argv[1]
+              << " into " << records << " records (" << out.bytes() << " bytes)\n";
+    std::cout << "Allocations: " << mallocs << ", still live at end: " << live.size() << "\n";
+    if (unknown_frees > 0)
+        std::cout << "Dropped " << unknown_frees << " frees of blocks allocated before the capture\n";
+    if (aliased > 0)
+        std::cout << "Warning: " << aliased << " allocations returned an address that was still live\n";
+    return 0;
+}
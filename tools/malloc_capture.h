@@ -0,0 +1,49 @@
+#ifndef MALLOC_CAPTURE_H
+#define MALLOC_CAPTURE_H
+
+#include <cstdint>
+
+/*
+Binary capture written by libmemsim_preload.so
+- Every thread logs into its own buffer and appends it to the capture
+  file as one chunk when the buffer fills, or when the thread exits
+- Events carry a global sequence number, so the converter can restore
+  the original order across threads
+- A successful realloc logs two events: REALLOC_RELEASE with a number
+  taken before the call, REALLOC with one taken after it returned
+
+File layout (native endian):
+| CHUNK | CHUNK | ... |
+CHUNK: | MAGIC (4) | THREAD (4) | COUNT (4) | RESERVED (4) | EVENT * COUNT |
+*/
+
+constexpr std::uint32_t CAPTURE_MAGIC = 0x5043534d; //"MSCP"
+//Events per chunk, the converter rejects larger counts as corrupt
+constexpr std::uint32_t CAPTURE_CHUNK_EVENTS = 4096;
+
+enum class CaptureOp : std::uint8_t {
+    MALLOC = 0,    //ptr = result, size
+    FREE = 1,      //ptr = freed pointer
+    CALLOC = 2,    //ptr = result, size = nmemb * size
+    REALLOC = 3,   //ptr = result, size, aux = old pointer
+    MEMALIGN = 4,  //ptr = result, size, aux = alignment
+    REALLOC_RELEASE = 5  //ptr = old pointer, size, before the REALLOC of the same thread
+};
+
+struct CaptureChunkHeader {
+    std::uint32_t magic;
+    std::uint32_t thread;
+    std::uint32_t count;
+    std::uint32_t reserved;
+};
+
+struct CaptureEvent {
+    std::uint64_t seq;
+    std::uint64_t ptr;
+    std::uint64_t size;
+    std::uint64_t aux;
+    std::uint8_t op;
+    std::uint8_t pad[7];
+};
+
+#endif
@@ -0,0 +1,198 @@
+#include "server.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+Client of the memsim daemon
+    memsim_client <socket> <session> [requests per frame]
+        REPL command lines from stdin, their output is printed in order
+    memsim_client <socket> <session> --trace <file.mst> [requests per frame]
+        stream a trace as binary requests and print a summary
+
+- A sender thread writes all frames while the main thread reads the
+  replies, so frames are pipelined instead of waiting for each reply
+- Trace FREE/REALLOC ordinals count from the start of the session, so a
+  trace is replayed into a fresh session
+*/
+
+namespace {
+
+bool write_all(int fd, const std::vector<char> &bytes) {
+    std::size_t sent = 0;
+    while (sent < bytes.size()) {
+        ssize_t n = send(fd, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        sent += n;
+    }
+    return true;
+}
+
+bool read_all(int fd, void *data, std::size_t size) {
+    char *p = static_cast<char *>(data);
+    while (size > 0) {
+        ssize_t n = read(fd, p, size);
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+//Frame of requests, text[i] follows requests[i] (COMMAND only)
+std::vector<char> encode_frame(const std::string &session, const std::vector<WireRequest> &requests,
+                               const std::vector<std::string> &text) {
+    std::vector<char> frame(sizeof(FrameHeader));
+    frame.insert(frame.end(), session.begin(), session.end());
+    for (std::size_t i = 0; i < requests.size(); i++) {
+        const char *bytes = reinterpret_cast<const char *>(&requests[i]);
+        frame.insert(frame.end(), bytes, bytes + sizeof(WireRequest));
+        if (i < text.size())
+            frame.insert(frame.end(), text[i].begin(), text[i].end());
+    }
+    FrameHeader header{static_cast<std::uint32_t>(frame.size() - sizeof(FrameHeader)),
+                       static_cast<std::uint32_t>(requests.size()),
+                       static_cast<std::uint16_t>(session.size()), 0};
+    std::memcpy(frame.data(), &header, sizeof(header));
+    return frame;
+}
+
+}
+
+
+int main(int argc, char **argv) {
+    bool trace_mode = argc >= 5 && std::string(argv[3]) == "--trace";
+    if (argc < 3 || (!trace_mode && argc > 4) || argc > 6) {
+        std::cout << "Usage: memsim_client <socket> <session> [requests per frame]\n"
+                     "       memsim_client <socket> <session> --trace <file.mst> [requests per frame]\n";
+        return 1;
+    }
+    std::string session = argv[2];
+    const char *per_frame_arg = trace_mode ? (argc > 5 ? argv[5] : nullptr) : (argc > 3 ? argv[3] : nullptr);
+    std::size_t per_frame = per_frame_arg ? std::stoul(per_frame_arg) : (trace_mode ? 4096 : 64);
+    if (per_frame == 0 || session.size() > 0xffff) {
+        std::cout << "Invalid session name or frame size\n";
+        return 1;
+    }
+
+    sockaddr_un addr{};
+    std::string path = argv[1];
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cout << "Socket path too long\n";
+        return 1;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+        std::cout << "Cannot connect to " << path << "\n";
+        return 1;
+    }
+
+    //Requests, grouped into frames by the sender
+    std::vector<WireRequest> requests;
+    std::vector<std::string> lines;
+    TraceReader reader;
+    if (trace_mode) {
+        if (!reader.open(argv[4])) {
+            std::cout << "Invalid trace file\n";
+            return 1;
+        }
+        std::vector<TraceRecord> block;
+        for (std::size_t b = 0; b < reader.blocks(); b++) {
+            if (!reader.decode_block(b, block)) {
+                std::cout << "Corrupt trace block\n";
+                return 1;
+            }
+            for (const TraceRecord &r : block)
+                requests.push_back({static_cast<std::uint8_t>(r.op), static_cast<std::uint8_t>(r.type), 0,
+                                    r.stream, r.value, r.arg});
+        }
+    } else {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            requests.push_back({COMMAND_OP, 0, 0, 0, line.size(), 0});
+            lines.push_back(line);
+        }
+    }
+
+    //frame boundaries, a BATCH and its records stay in one frame
+    std::vector<std::size_t> bounds{0};
+    while (bounds.back() < requests.size()) {
+        std::size_t first = bounds.back();
+        std::size_t last = std::min(requests.size(), first + per_frame);
+        for (std::size_t k = first; k < last; k++) {
+            if (requests[k].op == static_cast<std::uint8_t>(TraceOp::BATCH))
+                last = std::max<std::size_t>(last, std::min<std::uint64_t>(requests.size(), k + 1 + requests[k].value));
+        }
+        bounds.push_back(last);
+    }
+    std::size_t frames = bounds.size() - 1;
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread sender([&]() {
+        for (std::size_t f = 0; f < frames; f++) {
+            std::size_t first = bounds[f];
+            std::size_t last = bounds[f + 1];
+            std::vector<WireRequest> part(requests.begin() + first, requests.begin() + last);
+            std::vector<std::string> text;
+            if (!lines.empty())
+                text.assign(lines.begin() + first, lines.begin() + last);
+            if (!write_all(fd, encode_frame(session, part, text)))
+                break;
+        }
+        shutdown(fd, SHUT_WR);
+    });
+
+    std::uint64_t replies = 0, failed = 0;
+    std::uint64_t served[5] = {0, 0, 0, 0, 0};
+    bool ok = true;
+    for (std::size_t f = 0; f < frames && ok; f++) {
+        ReplyHeader header;
+        ok = read_all(fd, &header, sizeof(header));
+        std::vector<char> body(ok ? header.bytes : 0);
+        ok = ok && read_all(fd, body.data(), body.size());
+
+        const char *p = body.data();
+        for (std::uint32_t i = 0; ok && i < header.replies; i++) {
+            WireReply reply;
+            std::memcpy(&reply, p, sizeof(reply));
+            p += sizeof(reply);
+            replies++;
+            failed += reply.status != static_cast<std::uint8_t>(ReplyStatus::OK);
+            if (reply.served < 5)
+                served[reply.served]++;
+            if (reply.text_length > 0) {
+                std::cout.write(p, reply.text_length);
+                p += reply.text_length;
+            }
+        }
+    }
+    sender.join();
+    close(fd);
+    if (!ok) {
+        std::cout << "Connection closed by the daemon\n";
+        return 1;
+    }
+
+    if (trace_mode) {
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Sent " << requests.size() << " requests in " << frames << " frames, " << ms << " ms ("
+                  << (ms > 0 ? replies / ms / 1000.0 : 0.0) << " M requests/s)\n";
+        std::cout << "Failed or skipped: " << failed << "\n";
+        std::cout << "L1 hits " << served[static_cast<int>(ServedBy::L1)] << ", L2 hits "
+                  << served[static_cast<int>(ServedBy::L2)] << ", memory "
+                  << served[static_cast<int>(ServedBy::MEMORY)] << "\n";
+    }
+    return 0;
+}
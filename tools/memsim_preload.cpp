@@ -0,0 +1,315 @@
+#include "malloc_capture.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/*
+LD_PRELOAD malloc capture
+    LD_PRELOAD=./libmemsim_preload.so MEMSIM_CAPTURE=app.cap ./app
+
+- Interposes malloc, free, calloc, realloc and posix_memalign
+- Each thread appends events to its own mmap'd buffer, no locks on the
+  hot path; the only shared write is one relaxed fetch_add for ordering
+- A full buffer is written to the capture file as one chunk (O_APPEND),
+  the rest is flushed at thread exit and at process exit
+- Allocations made by the shim itself (dlsym, snprintf) are not logged
+
+Ordering: frees take their sequence number before the memory is
+released, allocations take theirs after it was handed out, so an address
+is never reused before its free in sequence order. realloc is both: the
+release of the old block and the new block get one number each.
+
+Threads still running at process exit are flushed best effort.
+*/
+
+namespace {
+
+using MallocFn = void *(*)(std::size_t);
+using FreeFn = void (*)(void *);
+using CallocFn = void *(*)(std::size_t, std::size_t);
+using ReallocFn = void *(*)(void *, std::size_t);
+using MemalignFn = int (*)(void **, std::size_t, std::size_t);
+
+MallocFn real_malloc = nullptr;
+FreeFn real_free = nullptr;
+CallocFn real_calloc = nullptr;
+ReallocFn real_realloc = nullptr;
+MemalignFn real_memalign = nullptr;
+
+//dlsym may allocate before the real functions are known
+alignas(16) char bootstrap[16384];
+std::atomic<std::size_t> bootstrap_used(0);
+std::atomic<bool> resolving(false);
+
+constexpr std::size_t MAX_THREADS = 1024;
+
+struct ThreadLog {
+    CaptureChunkHeader header;
+    CaptureEvent events[CAPTURE_CHUNK_EVENTS];
+    std::size_t slot;
+};
+
+std::atomic<std::uint64_t> next_seq(0);
+std::atomic<std::uint32_t> next_thread(0);
+std::atomic<int> capture_fd(-1);
+std::atomic<bool> stopping(false);
+//every live log, so process exit can flush threads that never exited
+std::atomic<ThreadLog *> logs[MAX_THREADS];
+
+pthread_key_t log_key;
+pthread_once_t key_once = PTHREAD_ONCE_INIT;
+
+__thread ThreadLog *tls_log __attribute__((tls_model("initial-exec"))) = nullptr;
+__thread bool tls_busy __attribute__((tls_model("initial-exec"))) = false;
+
+
+void *bootstrap_alloc(std::size_t size) {
+    std::size_t rounded = (size + 15) & ~std::size_t(15);
+    std::size_t offset = bootstrap_used.fetch_add(rounded);
+    if (offset + rounded > sizeof(bootstrap))
+        return nullptr;
+    return bootstrap + offset;
+}
+
+bool is_bootstrap(void *p) {
+    return p >= static_cast<void *>(bootstrap) && p < static_cast<void *>(bootstrap + sizeof(bootstrap));
+}
+
+void resolve() {
+    if (real_malloc || resolving.exchange(true))
+        return;
+    real_calloc = reinterpret_cast<CallocFn>(dlsym(RTLD_NEXT, "calloc"));
+    real_free = reinterpret_cast<FreeFn>(dlsym(RTLD_NEXT, "free"));
+    real_realloc = reinterpret_cast<ReallocFn>(dlsym(RTLD_NEXT, "realloc"));
+    real_memalign = reinterpret_cast<MemalignFn>(dlsym(RTLD_NEXT, "posix_memalign"));
+    real_malloc = reinterpret_cast<MallocFn>(dlsym(RTLD_NEXT, "malloc"));
+    resolving = false;
+}
+
+int open_capture() {
+    int fd = capture_fd.load();
+    if (fd >= 0)
+        return fd;
+
+    char path[256];
+    const char *env = std::getenv("MEMSIM_CAPTURE");
+    if (env && *env)
+        std::snprintf(path, sizeof(path), "%s", env);
+    else
+        std::snprintf(path, sizeof(path), "memsim-%d.cap", static_cast<int>(getpid()));
+
+    fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    int expected = -1;
+    if (fd >= 0 && !capture_fd.compare_exchange_strong(expected, fd)) {
+        ::close(fd);
+        fd = expected;
+    }
+    return fd;
+}
+
+//One write per chunk, O_APPEND keeps chunks of different threads whole
+void flush(ThreadLog *log) {
+    if (log->header.count == 0)
+        return;
+    int fd = open_capture();
+    if (fd >= 0) {
+        const char *p = reinterpret_cast<const char *>(&log->header);
+        std::size_t left = sizeof(CaptureChunkHeader) + log->header.count * sizeof(CaptureEvent);
+        while (left > 0) {
+            ssize_t n = ::write(fd, p, left);
+            if (n <= 0)
+                break;
+            p += n;
+            left -= static_cast<std::size_t>(n);
+        }
+    }
+    log->header.count = 0;
+}
+
+void release_log(ThreadLog *log) {
+    //whoever takes the slot owns the final flush
+    if (logs[log->slot].exchange(nullptr) == log) {
+        flush(log);
+        munmap(log, sizeof(ThreadLog));
+    }
+}
+
+void thread_exit(void *value) {
+    tls_busy = true;
+    release_log(static_cast<ThreadLog *>(value));
+    tls_log = nullptr;
+}
+
+void create_key() {
+    pthread_key_create(&log_key, thread_exit);
+}
+
+ThreadLog *thread_log() {
+    if (tls_log)
+        return tls_log;
+
+    void *p = mmap(nullptr, sizeof(ThreadLog), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return nullptr;
+
+    ThreadLog *log = static_cast<ThreadLog *>(p);
+    log->header.magic = CAPTURE_MAGIC;
+    log->header.thread = next_thread.fetch_add(1);
+    log->header.count = 0;
+    log->header.reserved = 0;
+
+    log->slot = MAX_THREADS;
+    for (std::size_t i = 0; i < MAX_THREADS; i++) {
+        ThreadLog *expected = nullptr;
+        if (logs[i].compare_exchange_strong(expected, log)) {
+            log->slot = i;
+            break;
+        }
+    }
+    if (log->slot == MAX_THREADS) {
+        munmap(p, sizeof(ThreadLog));
+        return nullptr;
+    }
+
+    pthread_once(&key_once, create_key);
+    pthread_setspecific(log_key, log);
+    tls_log = log;
+    return log;
+}
+
+void record(CaptureOp op, std::uint64_t seq, const void *ptr, std::size_t size, std::uint64_t aux) {
+    if (tls_busy || stopping.load(std::memory_order_relaxed))
+        return;
+    tls_busy = true;
+
+    ThreadLog *log = thread_log();
+    if (log) {
+        CaptureEvent &e = log->events[log->header.count];
+        e.seq = seq;
+        e.ptr = reinterpret_cast<std::uint64_t>(ptr);
+        e.size = size;
+        e.aux = aux;
+        e.op = static_cast<std::uint8_t>(op);
+        if (++log->header.count == CAPTURE_CHUNK_EVENTS)
+            flush(log);
+    }
+
+    tls_busy = false;
+}
+
+std::uint64_t take_seq() {
+    return next_seq.fetch_add(1, std::memory_order_relaxed);
+}
+
+__attribute__((constructor)) void capture_init() {
+    resolve();
+    open_capture();
+}
+
+__attribute__((destructor)) void capture_fini() {
+    stopping = true;
+    for (std::size_t i = 0; i < MAX_THREADS; i++) {
+        ThreadLog *log = logs[i].exchange(nullptr);
+        if (log)
+            flush(log);
+    }
+    int fd = capture_fd.exchange(-1);
+    if (fd >= 0)
+        ::close(fd);
+}
+
+}
+
+
+extern "C" {
+
+void *malloc(std::size_t size) {
+    if (!real_malloc) {
+        resolve();
+        if (!real_malloc)
+            return bootstrap_alloc(size);
+    }
+    void *p = real_malloc(size);
+    if (p)
+        record(CaptureOp::MALLOC, take_seq(), p, size, 0);
+    return p;
+}
+
+void free(void *p) {
+    if (!p || is_bootstrap(p))
+        return;
+    if (!real_free)
+        resolve();
+    record(CaptureOp::FREE, take_seq(), p, 0, 0);
+    real_free(p);
+}
+
+void *calloc(std::size_t nmemb, std::size_t size) {
+    if (!real_calloc) {
+        resolve();
+        if (!real_calloc) {
+            //bootstrap memory is zero initialized static storage
+            if (size && nmemb > SIZE_MAX / size)
+                return nullptr;
+            return bootstrap_alloc(nmemb * size);
+        }
+    }
+    void *p = real_calloc(nmemb, size);
+    if (p)
+        record(CaptureOp::CALLOC, take_seq(), p, nmemb * size, 0);
+    return p;
+}
+
+void *realloc(void *old, std::size_t size) {
+    if (!real_realloc) {
+        resolve();
+        if (!real_realloc)
+            return bootstrap_alloc(size);
+    }
+    if (is_bootstrap(old)) {
+        void *p = real_malloc(size);
+        if (p) {
+            std::size_t avail = static_cast<std::size_t>(bootstrap + sizeof(bootstrap) - static_cast<char *>(old));
+            std::memcpy(p, old, size < avail ? size : avail);
+            record(CaptureOp::MALLOC, take_seq(), p, size, 0);
+        }
+        return p;
+    }
+
+    if (!old) {
+        void *p = real_realloc(old, size);
+        if (p)
+            record(CaptureOp::REALLOC, take_seq(), p, size, 0);
+        return p;
+    }
+
+    //another thread may get old once it is released, before p is known
+    std::uint64_t release_seq = take_seq();
+    void *p = real_realloc(old, size);
+    if (p) {
+        record(CaptureOp::REALLOC_RELEASE, release_seq, old, size, 0);
+        record(CaptureOp::REALLOC, take_seq(), p, size, reinterpret_cast<std::uint64_t>(old));
+    } else if (size == 0) {
+        //realloc(p, 0) may free p and return nullptr
+        record(CaptureOp::REALLOC, release_seq, nullptr, 0, reinterpret_cast<std::uint64_t>(old));
+    }
+    return p;
+}
+
+int posix_memalign(void **out, std::size_t alignment, std::size_t size) {
+    if (!real_memalign)
+        resolve();
+    int rc = real_memalign(out, alignment, size);
+    if (rc == 0)
+        record(CaptureOp::MEMALIGN, take_seq(), *out, size, alignment);
+    return rc;
+}
+
+}